@@ -0,0 +1,279 @@
+/* drawbench.cxx: Times drawing of synthetic events into offscreen image
+ * surfaces, so that drawing speed can be compared between releases
+ * without needing a display or an art file.
+ *
+ * Usage: drawbench [label]
+ *
+ * Writes one JSON object per line to stdout, one for each combination of
+ * event type, zoom level and time window.  If given, 'label' is copied
+ * into each line to identify the release being measured. */
+
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include "event.h"
+#include "geo.h"
+#include "drawing.h"
+#include "hits.h"
+#include "tracks.h"
+#include "vertices.h"
+#include "layers.h"
+
+std::vector<noeevent> theevents;
+
+// The drawing code calls this to finish reading reco for events from art.
+// The events made here have their reco positions filled in directly.
+void convert_reco(noeevent & ev)
+{
+  ev.reco_converted = true;
+}
+
+extern int gevi;
+extern int pixx, pixy, FDpixy, NDpixy;
+extern int nplanes, ncells_perplane, first_mucatcher;
+extern bool isfd;
+extern int screenxoffset, screenyoffset_xview, screenyoffset_yview;
+extern cairo_surface_t * offscreen[kXorY];
+extern rect screenview[kXorY];
+
+// Deterministic so that runs are comparable
+static uint32_t rng = 12345;
+static uint32_t rand32()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static double now_ms()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e3 + ts.tv_nsec*1e-6;
+}
+
+// True if there is a cell at this plane and cell number in the current
+// detector.  Only the ND muon catcher has missing cells.
+static bool cell_exists(const int plane, const int cell)
+{
+  return !(plane >= first_mucatcher && plane%2 == 0 &&
+           cell >= 2*ncells_perplane/3);
+}
+
+static noeevent new_event(const int n)
+{
+  noeevent ev;
+  ev.nevent = n;
+  ev.nrun = 0;
+  ev.nsubrun = 0;
+  return ev;
+}
+
+// Every cell hit once, at various times and charges.  Formerly
+// add_test_fd_event() and add_test_nd_event() in the art module.
+static noeevent full_event()
+{
+  noeevent ev = new_event(0);
+  for(int c = 0; c < ncells_perplane; c++){
+    for(int p = 0; p < nplanes; p++){
+      if(!cell_exists(p, c)) continue;
+      hit thehit;
+      thehit.cell = c;
+      thehit.plane = p;
+      thehit.adc = (c*p)%(isfd?124:1234);
+      thehit.tdc = ((c*p)%(isfd?432:234))*4;
+      thehit.tns = thehit.tdc*1000/64.;
+      thehit.good_tns = true;
+      ev.addhit(thehit);
+    }
+  }
+  return ev;
+}
+
+// Add a straight track going from (plane0, cell0) to (plane1, cell1) at the
+// given time, with a hit and a trajectory point in each plane, and a vertex
+// at its start.
+static void add_muon(noeevent & ev, const int plane0, const int cell0,
+                     const int plane1, const int cell1, const int32_t tdc)
+{
+  track tr;
+  tr.startx = tr.starty = tr.stopx = tr.stopy = 0;
+  tr.startz = tr.stopz = 0;
+  tr.time = tdc;
+  tr.tns = tdc*1000/64.;
+
+  for(int p = plane0; p <= plane1; p++){
+    const float frac = plane1 == plane0? 0: float(p-plane0)/(plane1-plane0);
+    const float fcell = cell0 + frac*(cell1-cell0);
+
+    cppoint cp;
+    cp.plane = p;
+    cp.cell = (int)fcell;
+    cp.fcell = fcell - cp.cell;
+    cp.fplane = 0;
+    tr.traj[p%2 == 1?kX:kY].push_back(cp);
+
+    if(!cell_exists(p, cp.cell)) continue;
+    hit thehit;
+    thehit.plane = p;
+    thehit.cell = cp.cell;
+    thehit.adc = 100 + rand32()%400;
+    thehit.tdc = tdc + rand32()%8;
+    thehit.tns = thehit.tdc*1000/64.;
+    thehit.good_tns = true;
+    ev.addhit(thehit);
+  }
+  ev.addtrack(tr);
+
+  vertex vert;
+  vert.pos[kX] = tr.traj[kX][0];
+  vert.pos[kY] = tr.traj[kY][0];
+  vert.posx = vert.posy = vert.posz = 0;
+  vert.time = tdc;
+  vert.tns = tr.tns;
+  vert.layer = 1;
+  ev.addvertex(vert);
+}
+
+// Noise hits spread over the readout window, plus some muons
+static noeevent random_event(const int nnoise, const int nmuons,
+                             const int32_t readoutticks)
+{
+  noeevent ev = new_event(1);
+  for(int i = 0; i < nnoise; i++){
+    hit thehit;
+    do{
+      thehit.plane = rand32()%nplanes;
+      thehit.cell  = rand32()%ncells_perplane;
+    }while(!cell_exists(thehit.plane, thehit.cell));
+    thehit.adc = 10 + rand32()%100;
+    thehit.tdc = (rand32()%(readoutticks/4))*4;
+    thehit.tns = thehit.tdc*1000/64.;
+    thehit.good_tns = true;
+    ev.addhit(thehit);
+  }
+  for(int i = 0; i < nmuons; i++){
+    const int plane0 = rand32()%(nplanes/2);
+    add_muon(ev, plane0, rand32()%ncells_perplane,
+             plane0 + 2 + rand32()%(nplanes - plane0 - 2),
+             rand32()%ncells_perplane, rand32()%readoutticks);
+  }
+  return ev;
+}
+
+// Run 'f' a number of times and return the median time it took
+template<class F> static double time_median_ms(F f)
+{
+  std::vector<double> times;
+  const double start = now_ms();
+  while(times.size() < 3 || (times.size() < 25 && now_ms() - start < 500)){
+    const double t0 = now_ms();
+    f();
+    times.push_back(now_ms() - t0);
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size()/2];
+}
+
+static void make_surfaces()
+{
+  for(int i = 0; i < kXorY; i++){
+    if(offscreen[i] != NULL) cairo_surface_destroy(offscreen[i]);
+    offscreen[i] = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+      std::max(screenview[kX].xmax(), screenview[kY].xmax()) + 1,
+      std::max(screenview[kX].ymax(), screenview[kY].ymax()) + 1);
+  }
+}
+
+static void bench_event(const char * const label, const char * const name,
+                        noeevent ev)
+{
+  theevents.clear();
+  theevents.push_back(ev);
+  gevi = 0;
+  noeevent & E = theevents[0];
+
+  const int basepixy = isfd? FDpixy: NDpixy;
+  pixy = basepixy;
+  pixx = pixx_from_pixy(pixy);
+  screenxoffset = screenyoffset_xview = screenyoffset_yview = 0;
+  setboxes();
+  make_surfaces();
+
+  const int zooms[] = { 1, 2, 4 };
+  for(unsigned int z = 0; z < sizeof zooms/sizeof zooms[0]; z++){
+    pixy = basepixy*zooms[z];
+    pixx = pixx_from_pixy(pixy);
+    setboxes();
+
+    // The full event, the middle half, and the middle sixteenth
+    const int32_t span = E.maxtick - E.mintick, mid = E.mintick + span/2;
+    const int32_t halfwidths[] = { span/2 + 1, span/4, span/32 };
+    const char * const windownames[] = { "full", "half", "sixteenth" };
+    for(int w = 0; w < 3; w++){
+      E.current_mintick = mid - halfwidths[w];
+      E.current_maxtick = mid + halfwidths[w];
+
+      DRAWPARS drawpars;
+      drawpars.firsttick = E.current_mintick;
+      drawpars.lasttick  = E.current_maxtick;
+      drawpars.clear = true;
+
+      int nwindow = 0;
+      for(unsigned int i = 0; i < E.hits.size(); i++)
+        if(E.hits[i].tdc >= drawpars.firsttick &&
+           E.hits[i].tdc <= drawpars.lasttick) nwindow++;
+
+      const double event_ms =
+        time_median_ms([&]{ draw_event(&drawpars); });
+
+      cairo_t * cr[kXorY];
+      for(int i = 0; i < kXorY; i++) cr[i] = view_cairo(i);
+
+      const double hits_ms =
+        time_median_ms([&]{ draw_hits(cr, &drawpars); });
+      const double tracks_ms =
+        time_median_ms([&]{ draw_tracks(cr, &drawpars, 0); });
+      const double vertices_ms =
+        time_median_ms([&]{ draw_vertices(cr, &drawpars, 1); });
+
+      for(int i = 0; i < kXorY; i++) cairo_destroy(cr[i]);
+
+      printf("{\"label\":\"%s\",\"event\":\"%s\",\"detector\":\"%s\","
+             "\"nhits\":%d,\"ntracks\":%d,\"nvertices\":%d,"
+             "\"pixy\":%d,\"window\":\"%s\",\"nhits_in_window\":%d,"
+             "\"draw_event_ms\":%.3f,\"draw_hits_ms\":%.3f,"
+             "\"draw_tracks_ms\":%.3f,\"draw_vertices_ms\":%.3f}\n",
+             label, name, isfd?"FD":"ND", (int)E.hits.size(),
+             (int)E.tracks.size(), (int)E.vertices.size(), pixy,
+             windownames[w], nwindow,
+             event_ms, hits_ms, tracks_ms, vertices_ms);
+      fflush(stdout);
+    }
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  const char * const label = argc > 1? argv[1]: "";
+
+  // The muons' tracks and vertices, as the module would lay them out
+  layer_add("tracks", true);
+  layer_add("vertices", false);
+
+  // Near Detector first, since we can't switch back after setfd()
+  bench_event(label, "full",      full_event());
+  bench_event(label, "cosmic",    random_event(300, 2, 50*64));
+  bench_event(label, "spill",     random_event(1000000, 200, 10*64));
+
+  setfd();
+  bench_event(label, "full",      full_event());
+  bench_event(label, "cosmic",    random_event(20000, 10, 550*64));
+  bench_event(label, "spill",     random_event(1000000, 200, 550*64));
+
+  return 0;
+}
@@ -0,0 +1,268 @@
+/* ingestbench.cxx: Times the conversion of art reconstruction objects into
+ * NOE's own structures, as done in noe::produce() and convert_reco(), using
+ * stand-ins for the art types and the geometry service.
+ *
+ * Usage: ingestbench [label]
+ *
+ * Writes one JSON object per line to stdout, one for each kind of event.
+ * If given, 'label' is copied into each line to identify the release being
+ * measured. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <new>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "event.h"
+
+// Count allocations so that we can report them per event
+static long nallocs = 0;
+
+void * operator new(size_t n)
+{
+  nallocs++;
+  void * const p = malloc(n? n: 1);
+  if(p == NULL) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void * p) noexcept
+{
+  free(p);
+}
+
+/*********************************************************************/
+/*             Stand-ins for the art and NOvA types                  */
+/*********************************************************************/
+
+struct fakevector{
+  double x, y, z;
+  double X() const { return x; }
+  double Y() const { return y; }
+  double Z() const { return z; }
+};
+
+struct fakecellhit{
+  uint16_t cell, plane;
+  int16_t adc;
+  int32_t tdc;
+  float tns;
+  unsigned short Cell()  const { return cell; }
+  unsigned short Plane() const { return plane; }
+  int16_t ADC() const { return adc; }
+  int32_t TDC() const { return tdc; }
+  float TNS() const { return tns; }
+  bool GoodTiming() const { return true; }
+};
+
+struct faketrack{
+  fakevector start, stop;
+  double meantns;
+  std::vector<fakecellhit> cells;
+  std::vector<fakevector> traj;
+  const fakevector & Start() const { return start; }
+  const fakevector & Stop()  const { return stop;  }
+  double MeanTNS() const { return meantns; }
+  unsigned int NCell() const { return cells.size(); }
+  const fakecellhit * Cell(const unsigned int c) const { return &cells[c]; }
+  unsigned int NTrajectoryPoints() const { return traj.size(); }
+  const fakevector & TrajectoryPoint(const unsigned int p) const
+  {
+    return traj[p];
+  }
+};
+
+// Acts like art::Ptr<rb::CellHit> for slices
+struct fakeptr{
+  unsigned int k;
+  int id() const { return 0; }
+  unsigned int key() const { return k; }
+};
+
+struct fakecluster{
+  bool noise;
+  std::vector<fakeptr> cells;
+  bool IsNoise() const { return noise; }
+  unsigned int NCell() const { return cells.size(); }
+  const fakeptr & Cell(const unsigned int c) const { return cells[c]; }
+};
+
+struct fakevertex{
+  double x, y, z, t;
+  double GetX() const { return x; }
+  double GetY() const { return y; }
+  double GetZ() const { return z; }
+  double GetT() const { return t; }
+};
+
+// A regular Far-Detector-like geometry.  Odd planes are in the x view.
+namespace geo {
+  enum View_t { kX, kY };
+
+  struct PlaneGeo{
+    unsigned int Ncells() const { return 384; }
+  };
+
+  struct Geometry{
+    PlaneGeo theplane;
+    unsigned int NPlanes() const { return 896; }
+    const PlaneGeo * Plane(const unsigned int) const { return &theplane; }
+    void CellInfo(const unsigned int plane, const unsigned int cell,
+                  View_t * view, double * pos, double * dpos) const
+    {
+      *view = plane%2 == 1? kX: kY;
+      const double t = (cell - 192.0)*3.9674375;
+      pos[0] = *view == kX? t: 0;
+      pos[1] = *view == kY? t: 0;
+      pos[2] = plane*6.6681604;
+      dpos[0] = dpos[1] = dpos[2] = 0;
+    }
+  };
+}
+
+// Acts like art::ServiceHandle<geo::Geometry>
+struct fakehandle{
+  geo::Geometry g;
+  geo::Geometry * operator->() { return &g; }
+};
+
+#include "ingest.h"
+
+/*********************************************************************/
+/*                          Benchmarking                             */
+/*********************************************************************/
+
+static uint32_t rng = 12345;
+static uint32_t rand32()
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+static double now_s()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static fakevector random_point()
+{
+  fakevector v;
+  v.x = (int(rand32()%1500) - 750)/1.0;
+  v.y = (int(rand32()%1500) - 750)/1.0;
+  v.z = rand32()%5900;
+  return v;
+}
+
+static void bench(const char * const label, const char * const name,
+                  const int nhits, const int ntracks, const int ntrajpoints,
+                  const int nvertices, const int nslices)
+{
+  std::vector<fakecellhit> hits(nhits);
+  for(int i = 0; i < nhits; i++){
+    hits[i].plane = rand32()%896;
+    hits[i].cell  = rand32()%384;
+    hits[i].adc   = rand32()%1000;
+    hits[i].tdc   = rand32()%35200;
+    hits[i].tns   = hits[i].tdc*1000/64.;
+  }
+
+  std::vector<faketrack> tracks(ntracks);
+  for(int i = 0; i < ntracks; i++){
+    tracks[i].start = random_point();
+    tracks[i].stop  = random_point();
+    tracks[i].meantns = rand32()%550000;
+    tracks[i].cells.assign(hits.begin(),
+                           hits.begin() + std::min(nhits, ntrajpoints));
+    for(int p = 0; p < ntrajpoints; p++){
+      const double f = double(p)/std::max(1, ntrajpoints-1);
+      fakevector v;
+      v.x = tracks[i].start.x + f*(tracks[i].stop.x - tracks[i].start.x);
+      v.y = tracks[i].start.y + f*(tracks[i].stop.y - tracks[i].start.y);
+      v.z = tracks[i].start.z + f*(tracks[i].stop.z - tracks[i].start.z);
+      tracks[i].traj.push_back(v);
+    }
+  }
+
+  std::vector<fakevertex> vertices(nvertices);
+  for(int i = 0; i < nvertices; i++){
+    const fakevector v = random_point();
+    vertices[i].x = v.x, vertices[i].y = v.y, vertices[i].z = v.z;
+    vertices[i].t = rand32()%550000;
+  }
+
+  // A noise slice followed by the real ones, each hit in one of them
+  std::vector<fakecluster> slices(nslices? nslices+1: 0);
+  for(unsigned int s = 0; s < slices.size(); s++) slices[s].noise = s == 0;
+  for(int i = 0; nslices && i < nhits; i++){
+    fakeptr p;
+    p.k = i;
+    slices[rand32()%slices.size()].cells.push_back(p);
+  }
+
+  static fakehandle geo;
+
+  // Build the lookup table outside of the timing
+  cart_to_cp(geo, 0, 0, 0);
+
+  // Repeat until enough time has gone by to be meaningful
+  int nevents = 0;
+  double filltime = 0, recotime = 0;
+  long fillallocs = 0, recoallocs = 0;
+  while(nevents < 3 || filltime + recotime < 1){
+    noeevent ev;
+
+    long a0 = nallocs;
+    double t0 = now_s();
+    fill_event(ev, hits);
+    add_tracks(ev, tracks, 0);
+    add_vertices(ev, vertices, 1);
+    fill_slices(ev, slices, 0);
+    index_hits(ev);
+    summarize_event(ev);
+    filltime += now_s() - t0;
+    fillallocs += nallocs - a0;
+
+    a0 = nallocs;
+    t0 = now_s();
+    convert_reco_with_geo(geo, ev);
+    recotime += now_s() - t0;
+    recoallocs += nallocs - a0;
+
+    nevents++;
+  }
+
+  const double ntrajtotal = double(ntracks)*ntrajpoints + nvertices;
+
+  printf("{\"label\":\"%s\",\"event\":\"%s\",\"nhits\":%d,\"ntracks\":%d,"
+         "\"ntrajpoints_per_track\":%d,\"nvertices\":%d,\"nslices\":%d,"
+         "\"nevents\":%d,"
+         "\"hits_per_s\":%.4g,\"events_per_s\":%.4g,"
+         "\"trajpoints_per_s\":%.4g,"
+         "\"allocs_per_event_read\":%.1f,\"allocs_per_event_reco\":%.1f}\n",
+         label, name, nhits, ntracks, ntrajpoints, nvertices, nslices, nevents,
+         nhits*nevents/filltime, nevents/filltime,
+         recotime > 0? ntrajtotal*nevents/recotime: 0,
+         double(fillallocs)/nevents, double(recoallocs)/nevents);
+  fflush(stdout);
+}
+
+int main(int argc, char ** argv)
+{
+  const char * const label = argc > 1? argv[1]: "";
+
+  bench(label, "hits only",       20000,    0,    0,  0,  0);
+  bench(label, "cosmic",          20000,   20,  200,  5, 10);
+  bench(label, "many tracks",     20000,  300,  200, 50, 50);
+  bench(label, "long tracks",     20000,   10, 5000,  5, 10);
+  bench(label, "spill",         1000000,  200,  200, 50, 50);
+
+  return 0;
+}
@@ -27,11 +27,11 @@ doit()
   if [ "$type" != default ]; then
      echo "UUDDLRLRBAS: @local::standard_noe"
      if [ $type != "notracks" ]; then
-       trklabel=kalmantrackmerge
+       trklabels='"kalmantrackmerge"'
      fi
-     printf 'UUDDLRLRBAS.track_label: "'$trklabel'"\n'
+     printf 'UUDDLRLRBAS.track_labels: ['$trklabels']\n'
      if [ "$type" == "notracks" ]; then
-       printf 'UUDDLRLRBAS.vertex_label: "'$vtxlabel'"\n\n'
+       printf 'UUDDLRLRBAS.vertex_labels: []\n\n'
      else
        printf '\n'
      fi
@@ -1,4 +1,7 @@
-// Given a screen position and a track, defined by points in screen 
-// coordinates, return how far the screen position is from the track.
-float screen_dist_to_track(const int x, const int y,
-  const std::vector< std::pair<int, int> > & track);
+// Given a screen position and a track, defined by the x and y screen
+// coordinates of its 'n' points, return the square of the distance from the
+// position to the closest point on the track.  Returns FLT_MAX if the track
+// has fewer than two points.
+float screen_dist2_to_track(const float x, const float y,
+                            const float * const tx, const float * const ty,
+                            const int n);
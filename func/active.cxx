@@ -11,24 +11,77 @@
 #include "tracks.h"
 #include "vertices.h"
 #include "status.h"
+#include "pickgrid.h"
+#include "active.h"
+#include "layers.h"
+#include "merge.h"
 
 extern std::vector<noeevent> theevents;
 extern int gevi;
 
 extern int first_mucatcher, ncells_perplane;
 
-// The positions of all the track points on the screen.  We save this
+// The positions of all the track points on the screen, one entry for each
+// track of the current event, whether or not it is shown.  We save this
 // separately from the physical tracks so that we can quickly calculate
 // which track the user is mousing over.  Same idea for vertices.
 std::vector<screentrack_t> screentracks[kXorY];
 std::vector<screenvertex_t> screenvertices[kXorY];
 
+// Where on the screen the above are, so that only those near the mouse
+// pointer need to be checked.  These hold indices into screentracks and
+// screenvertices.
+static pickgrid trackgrid[kXorY], vertexgrid[kXorY];
+
 extern int active_plane, active_cell, active_track, active_vertex;
 
 // How close the mouse pointer should be to a reconstructed object for
 // it to make that object active.
 static const int min_pix_to_be_close = 20;
 
+void index_screentracks(const noe_view_t V)
+{
+  pickgrid_reset(trackgrid[V], view_width(V), view_height(V),
+                 min_pix_to_be_close);
+
+  // Index each segment separately, since a whole track's bounding box
+  // can easily cover most of the screen.
+  // Left from another event if none of this one's were drawn
+  if(screentracks[V].size() != theevents[gevi].tracks.size()) return;
+
+  const int dx = pan_x(), dy = pan_y(V);
+  for(unsigned int i = 0; i < screentracks[V].size(); i++){
+    if(!screentracks[V][i].shown ||
+       !layer_enabled(theevents[gevi].tracks[i].layer)) continue;
+    const std::vector<float> & tx = screentracks[V][i].x,
+                             & ty = screentracks[V][i].y;
+    for(unsigned int j = 0; j+1 < tx.size(); j++)
+      pickgrid_add(trackgrid[V], i,
+                   std::min(tx[j], tx[j+1]) - dx,
+                   std::min(ty[j], ty[j+1]) - dy,
+                   std::max(tx[j], tx[j+1]) - dx,
+                   std::max(ty[j], ty[j+1]) - dy);
+  }
+}
+
+void index_screenvertices(const noe_view_t V)
+{
+  pickgrid_reset(vertexgrid[V], view_width(V), view_height(V),
+                 min_pix_to_be_close);
+
+  // Left from another event if none of this one's were drawn
+  if(screenvertices[V].size() != theevents[gevi].vertices.size()) return;
+
+  const int dx = pan_x(), dy = pan_y(V);
+  for(unsigned int i = 0; i < screenvertices[V].size(); i++){
+    if(!screenvertices[V][i].shown ||
+       !layer_enabled(theevents[gevi].vertices[i].layer)) continue;
+    const std::pair<int, int> & pos = screenvertices[V][i].pos;
+    pickgrid_add(vertexgrid[V], i, pos.first - dx, pos.second - dy,
+                                   pos.first - dx, pos.second - dy);
+  }
+}
+
 // Given a screen position, return the closest vertex. If the position
 // is nowhere near a vertex, can return -1. If there are no vertices,
 // returns -1.
@@ -37,14 +90,18 @@ static int screen_to_activevertex(const noe_view_t view,
 {
   if(theevents[gevi].vertices.empty()) return -1;
 
+  static std::vector<int> near;
+  pickgrid_candidates(vertexgrid[view], x, y, min_pix_to_be_close, near);
+
   int closesti = -1;
   float mindist = FLT_MAX;
-  for(unsigned int i = 0; i < screenvertices[view].size(); i++){
-    const float dist = hypot(x-screenvertices[view][i].pos.first,
-                             y-screenvertices[view][i].pos.second);
+  for(unsigned int n = 0; n < near.size(); n++){
+    const screenvertex_t & sv = screenvertices[view][near[n]];
+    const float dist = hypot(x + pan_x()    - sv.pos.first,
+                             y + pan_y(view) - sv.pos.second);
     if(dist < mindist){
       mindist = dist;
-      closesti = screenvertices[view][i].i; // index into the full vertex array
+      closesti = sv.i; // index into the full vertex array
     }
   }
 
@@ -62,24 +119,33 @@ static int screen_to_activetrack(const noe_view_t view,
 {
   if(theevents[gevi].tracks.empty()) return -1;
 
+  static std::vector<int> near;
+  pickgrid_candidates(trackgrid[view], x, y, min_pix_to_be_close, near);
+
   int closesti = -1;
-  float mindist = FLT_MAX;
-  for(unsigned int i = 0; i < screentracks[view].size(); i++){
-    const float dist = screen_dist_to_track(x, y, screentracks[view][i].traj);
-    if(dist < mindist){
-      mindist = dist;
-      closesti = screentracks[view][i].i; // index into the full track array
+  float mindist2 = FLT_MAX;
+  for(unsigned int n = 0; n < near.size(); n++){
+    const screentrack_t & st = screentracks[view][near[n]];
+    // The track's positions leave out the pan offsets
+    const float dist2 = screen_dist2_to_track(x + pan_x(), y + pan_y(view),
+                                      st.x.data(), st.y.data(), st.x.size());
+    if(dist2 < mindist2){
+      mindist2 = dist2;
+      closesti = st.i; // index into the full track array
     }
   }
 
-  if(mindist < min_pix_to_be_close) return closesti;
+  if(mindist2 < min_pix_to_be_close*min_pix_to_be_close) return closesti;
   return -1;
 }
 
-static bool visible_hit(const int32_t tdc, const int TDCSTEP)
+static bool visible_hit(const hit & h, const int TDCSTEP)
 {
-  return tdc <= theevents[gevi].current_maxtick &&
-         tdc >= theevents[gevi].current_mintick - (TDCSTEP-1);
+  const noeevent & E = shown_event();
+  if(E.current_by_tns)
+    return h.tns <= E.current_maxtns && h.tns > E.current_mintns;
+  return h.tdc <= E.current_maxtick &&
+         h.tdc >= E.current_mintick - (TDCSTEP-1);
 }
 
 // Given a screen position, returns the cell number.  If no hit cell is in this
@@ -101,7 +167,7 @@ static int screen_to_activecell(noe_view_t view, const int x,
   int mindist = 9999, closestcell = -1;
   for(unsigned int i = 0; i < THEhits.size(); i++){
     if(THEhits[i].plane != plane) continue;
-    if(!visible_hit(THEhits[i].tdc, TDCSTEP)) continue;
+    if(!visible_hit(THEhits[i], TDCSTEP)) continue;
     const int dist = abs(THEhits[i].cell - c);
     if(dist < mindist){
       mindist = dist;
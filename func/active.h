@@ -1,2 +1,8 @@
 void update_active_indices(const noe_view_t V, const int x, const int y,
                            const int TDCSTEP);
+
+// Rebuild the index of which tracks or vertices are where on the screen in
+// the given view.  Must be called whenever screentracks or screenvertices
+// changes.
+void index_screentracks(const noe_view_t V);
+void index_screenvertices(const noe_view_t V);
@@ -0,0 +1,228 @@
+/* compose.cxx: Putting the views together from their layers (see
+ * compose.h).  Each layer notes the areas of the views that it changed.  A
+ * frame is made only in those areas: the hit layer is painted in, the
+ * highlighted cell drawn, the layers of reco objects painted on top and the
+ * highlighted track and vertex drawn last.  Then only those areas are sent
+ * to the screen.  Moving the mouse from one cell to the next redraws two
+ * cells, and since nothing is drawn over in place, unhighlighting something
+ * restores exactly what was under it.
+ *
+ * The highlights are only a few objects, so they are drawn straight into the
+ * frame rather than kept in surfaces of their own. */
+
+#include <gtk/gtk.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include "event.h"
+#include "geo.h"
+#include "drawing.h"
+#include "hits.h"
+#include "tracks.h"
+#include "vertices.h"
+#include "active.h"
+#include "layers.h"
+#include "present.h"
+#include "perf.h"
+#include "trace.h"
+#include "compose.h"
+
+extern int active_plane, active_cell, active_track, active_vertex;
+extern cairo_pattern_t * eventpattern[kXorY];
+extern std::vector<screentrack_t> screentracks[kXorY];
+extern std::vector<screenvertex_t> screenvertices[kXorY];
+
+// The changed areas of each layer in each view, which don't overlap
+static std::vector<rect> damage[NCOMPLAYERS][kXorY];
+
+// Past this many separate areas in a view, use one covering all of them,
+// since clipping to many small areas costs more than it saves
+static const unsigned int MAXAREAS = 16;
+
+// What was highlighted in the last frame
+static int shownplane = -1, showncell = -1;
+static int showntrack = -1, shownvertex = -1;
+
+// Extend 'r' to also cover 'o'.  An empty 'r' becomes 'o'.
+static void rect_union(rect & r, const rect & o)
+{
+  if(o.xsize <= 0 || o.ysize <= 0) return;
+  if(r.xsize <= 0 || r.ysize <= 0){ r = o; return; }
+  const int xmax = std::max(r.xmin + r.xsize, o.xmin + o.xsize);
+  const int ymax = std::max(r.ymin + r.ysize, o.ymin + o.ysize);
+  r.xmin = std::min(r.xmin, o.xmin);
+  r.ymin = std::min(r.ymin, o.ymin);
+  r.xsize = xmax - r.xmin;
+  r.ysize = ymax - r.ymin;
+}
+
+// Add r to a list of areas, merging it with any that it overlaps
+static void add_area(std::vector<rect> & areas, rect r)
+{
+  for(unsigned int i = 0; i < areas.size(); ){
+    if(!areas[i].overlaps(r)){
+      i++;
+      continue;
+    }
+
+    // The merged area might overlap ones already passed
+    rect_union(r, areas[i]);
+    areas[i] = areas.back();
+    areas.pop_back();
+    i = 0;
+  }
+
+  if(areas.size() >= MAXAREAS){
+    for(unsigned int i = 0; i < areas.size(); i++) rect_union(r, areas[i]);
+    areas.clear();
+  }
+  areas.push_back(r);
+}
+
+void compose_damage(const complayer L, const int V, const rect & r)
+{
+  const int xmin = std::max(0, r.xmin), ymin = std::max(0, r.ymin);
+  const int xmax = std::min(r.xmin + r.xsize, view_width(V));
+  const int ymax = std::min(r.ymin + r.ysize, view_height(V));
+  if(xmax <= xmin || ymax <= ymin) return;
+
+  rect c;
+  c.xmin = xmin, c.ymin = ymin;
+  c.xsize = xmax - xmin, c.ysize = ymax - ymin;
+  add_area(damage[L][V], c);
+}
+
+void compose_damage_all(const complayer L)
+{
+  for(int V = 0; V < kXorY; V++){
+    rect r;
+    r.xmin = r.ymin = 0;
+    r.xsize = view_width(V), r.ysize = view_height(V);
+    damage[L][V].clear();
+    compose_damage(L, V, r);
+  }
+}
+
+// The ticks (or ns) of what is shown.  The frame is made from the hit layer
+// each time, so this is everything shown so far, which in an animation is
+// more than drawpars, which only has the hits to add.
+static DRAWPARS shown_range(const DRAWPARS * const drawpars)
+{
+  DRAWPARS r;
+  set_drawpars_current(r);
+  r.clear = true;
+  if(r.bytns != drawpars->bytns) return *drawpars;
+  r.firsttick = std::min(r.firsttick, drawpars->firsttick);
+  r.lasttick  = std::max(r.lasttick,  drawpars->lasttick);
+  r.firsttns  = std::min(r.firsttns,  drawpars->firsttns);
+  r.lasttns   = std::max(r.lasttns,   drawpars->lasttns);
+  return r;
+}
+
+static void damage_cell(const int plane, const int cell)
+{
+  if(plane < 0 || cell < 0) return;
+  compose_damage(compcell, plane%2 == 1? kX: kY, cell_box(plane, cell));
+}
+
+// The reco layers note their own changes when the highlighted track or
+// vertex is put back in or taken out of them
+static void damage_track(const int i)
+{
+  for(int V = 0; V < kXorY; V++)
+    if(i >= 0 && i < (int)screentracks[V].size() &&
+       screentracks[V][i].shown)
+      compose_damage(comphighlight, V, screentracks[V][i].box);
+}
+
+static void damage_vertex(const int i)
+{
+  for(int V = 0; V < kXorY; V++)
+    if(i >= 0 && i < (int)screenvertices[V].size() &&
+       screenvertices[V][i].shown)
+      compose_damage(comphighlight, V, screenvertices[V][i].box);
+}
+
+// Note the areas where what is highlighted changed since the last frame
+static void damage_highlights()
+{
+  if(active_plane != shownplane || active_cell != showncell){
+    damage_cell(shownplane, showncell);
+    damage_cell(active_plane, active_cell);
+  }
+  if(active_track != showntrack){
+    damage_track(showntrack);
+    damage_track(active_track);
+  }
+  if(active_vertex != shownvertex){
+    damage_vertex(shownvertex);
+    damage_vertex(active_vertex);
+  }
+  shownplane = active_plane, showncell = active_cell;
+  showntrack = active_track, shownvertex = active_vertex;
+}
+
+void compose_views(const DRAWPARS * const drawpars)
+{
+  trace_begin("compose_views");
+  const DRAWPARS shown = shown_range(drawpars);
+
+  damage_highlights();
+
+  if(update_layers(&shown)){
+    for(int V = 0; V < kXorY; V++){
+      index_screentracks((noe_view_t)V);
+      index_screenvertices((noe_view_t)V);
+    }
+  }
+
+  // What changed in any layer
+  std::vector<rect> areas[kXorY];
+  bool any = false;
+  for(int V = 0; V < kXorY; V++){
+    for(int L = 0; L < NCOMPLAYERS; L++){
+      for(unsigned int i = 0; i < damage[L][V].size(); i++)
+        add_area(areas[V], damage[L][V][i]);
+      damage[L][V].clear();
+    }
+    if(!areas[V].empty()) any = true;
+  }
+  if(!any){
+    trace_end("compose_views");
+    return;
+  }
+
+  // With no areas in a view, the clip leaves nothing to draw there
+  cairo_t * cr[kXorY];
+  perf_begin(perfsave);
+  for(int V = 0; V < kXorY; V++){
+    cr[V] = view_cairo(V);
+    for(unsigned int i = 0; i < areas[V].size(); i++)
+      cairo_rectangle(cr[V], areas[V][i].xmin, areas[V][i].ymin,
+                             areas[V][i].xsize, areas[V][i].ysize);
+    cairo_clip(cr[V]);
+
+    cairo_set_source(cr[V], eventpattern[V]);
+    cairo_set_operator(cr[V], CAIRO_OPERATOR_SOURCE);
+    cairo_paint(cr[V]);
+    cairo_set_operator(cr[V], CAIRO_OPERATOR_OVER);
+  }
+  perf_end(perfsave);
+
+  draw_active_cell(cr, &shown);
+  paint_layers(cr);
+  draw_active_track(cr);
+  draw_active_vertex(cr);
+
+  perf_begin(perfblit);
+  for(int V = 0; V < kXorY; V++){
+    cairo_destroy(cr[V]);
+    for(unsigned int i = 0; i < areas[V].size(); i++)
+      present_damage(V, areas[V][i].xmin, areas[V][i].ymin,
+                        areas[V][i].xsize, areas[V][i].ysize);
+  }
+  present_views();
+  perf_end(perfblit);
+
+  trace_end("compose_views");
+}
@@ -0,0 +1,30 @@
+// Putting each view together from layers.  Each layer is drawn on its own,
+// and says which areas of the views it changed.  Only those areas are put
+// together again and sent to the screen.  From the bottom up:
+enum complayer{
+  // The detector boxes and hits, as drawn by draw_event()
+  comphits,
+
+  // The hits of the cell under the mouse pointer, brightened
+  compcell,
+
+  // The tracks and vertices, one surface for each collection (see layers.h)
+  compreco,
+
+  // The track and vertex under the mouse pointer
+  comphighlight,
+
+  NCOMPLAYERS
+};
+
+// Note that layer L changed in the area r of view V
+void compose_damage(const complayer L, const int V, const rect & r);
+
+// Note that layer L changed everywhere in both views
+void compose_damage_all(const complayer L);
+
+// Bring the layers up to date for showing what is in the range of drawpars
+// plus what is already shown, then put the changed areas together and on
+// the screen.  The highlighted cell, track and vertex are compared to those
+// last shown, so changing them only needs a call to this.
+void compose_views(const DRAWPARS * const drawpars);
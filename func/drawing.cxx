@@ -2,12 +2,17 @@
 #include <vector>
 #include <stdint.h>
 #include "event.h"
-#include "drawing.h"
 #include "status.h"
 #include "geo.h"
+#include "drawing.h"
 #include "hits.h"
 #include "tracks.h"
 #include "vertices.h"
+#include "perf.h"
+#include "present.h"
+#include "merge.h"
+#include "prerender.h"
+#include "compose.h"
 
 extern std::vector<noeevent> theevents;
 extern int gevi;
@@ -18,12 +23,68 @@ extern int nplanes;
 
 
 GtkWidget * edarea[kXorY] = { NULL }; // X and Y views
+
+// The background and hits of each view, without reco objects or anything
+// highlighted, so that we can easily redraw with other things on top later
+// (see compose.cxx).  The surfaces live as long as the views stay the same
+// size and are drawn into in place.
 cairo_pattern_t * eventpattern[kXorY] = { NULL };
+static cairo_surface_t * hitlayer[kXorY] = { NULL };
+static int hitlayerw[kXorY] = { 0 }, hitlayerh[kXorY] = { 0 };
 
-// Blank the drawing area and draw the detector bounding boxes
-static void draw_background(cairo_t ** cr)
+// If set, drawing goes to these instead of to edarea, e.g. to render events
+// without a display.  See present.cxx for when they are set.
+cairo_surface_t * offscreen[kXorY] = { NULL };
+
+cairo_t * view_cairo(const int V)
+{
+  if(offscreen[V] != NULL) return cairo_create(offscreen[V]);
+  return gdk_cairo_create(edarea[V]->window);
+}
+
+// With a window, the offscreen surface is made to match it, and might not be
+// an image surface, so ask the window.
+int view_width(const int V)
+{
+  if(edarea[V] != NULL) return edarea[V]->allocation.width;
+  return cairo_image_surface_get_width(offscreen[V]);
+}
+
+int view_height(const int V)
+{
+  if(edarea[V] != NULL) return edarea[V]->allocation.height;
+  return cairo_image_surface_get_height(offscreen[V]);
+}
+
+// Make the hit layers match the size of the views, keeping the ones that
+// already do.  New ones are made like the surfaces the views draw to, so
+// that copying between them is fast.  Returns true if any were remade,
+// in which case they hold nothing yet.
+static bool prepare_hit_layers()
+{
+  bool remade = false;
+  for(int V = 0; V < kXorY; V++){
+    const int w = std::max(1, view_width(V)), h = std::max(1, view_height(V));
+    if(hitlayer[V] != NULL && hitlayerw[V] == w && hitlayerh[V] == h)
+      continue;
+
+    if(eventpattern[V] != NULL) cairo_pattern_destroy(eventpattern[V]);
+    if(hitlayer[V] != NULL) cairo_surface_destroy(hitlayer[V]);
+
+    cairo_t * cr = view_cairo(V);
+    hitlayer[V] = cairo_surface_create_similar(cairo_get_target(cr),
+                                               CAIRO_CONTENT_COLOR, w, h);
+    cairo_destroy(cr);
+    eventpattern[V] = cairo_pattern_create_for_surface(hitlayer[V]);
+    hitlayerw[V] = w, hitlayerh[V] = h;
+    remade = true;
+  }
+  return remade;
+}
+
+void draw_boxes(cairo_t ** cr, const rect * const views,
+                const rect * const mu)
 {
-  setboxes();
   for(int i = 0; i < kXorY; i++){
     cairo_set_source_rgb(cr[i], 0, 0, 0);
     cairo_paint(cr[i]);
@@ -32,29 +93,46 @@ static void draw_background(cairo_t ** cr)
     cairo_set_line_width(cr[i], 1.0);
 
     // detector box
-    cairo_rectangle(cr[i], 0.5+screenview[i].xmin, 0.5+screenview[i].ymin,
-                               screenview[i].xsize,    screenview[i].ysize);
+    cairo_rectangle(cr[i], 0.5+views[i].xmin, 0.5+views[i].ymin,
+                               views[i].xsize,    views[i].ysize);
     cairo_stroke(cr[i]);
   }
 
   // Y-view muon catcher empty box
-  if(first_mucatcher < nplanes){
-    cairo_rectangle(cr[kY], 0.5+screenmu.xmin, 0.5+screenmu.ymin,
-                            screenmu.xsize, screenmu.ysize);
+  if(mu != NULL){
+    cairo_rectangle(cr[kY], 0.5+mu->xmin, 0.5+mu->ymin,
+                            mu->xsize, mu->ysize);
     cairo_stroke(cr[kY]);
   }
 }
 
+// Blank the drawing area and draw the detector bounding boxes
+static void draw_background(cairo_t ** cr)
+{
+  setboxes();
+  draw_boxes(cr, screenview, first_mucatcher < nplanes? &screenmu: NULL);
+}
+
 
 // Size the drawing areas to the detector sizes at the starting zoom level.
 // This would not make sense if called after the user zooms and pans, so it
 // is only called on startup.
 void request_edarea_size()
 {
+  const int w = std::max(screenview[kX].xmax(), screenview[kY].xmax()) + 1;
+  const int h = std::max(screenview[kX].ymax(), screenview[kY].ymax()) + 1;
   for(int i = 0; i < kXorY; i++)
-    gtk_widget_set_size_request(edarea[i],
-      std::max(screenview[kX].xmax(), screenview[kY].xmax()) + 1,
-      std::max(screenview[kX].ymax(), screenview[kY].ymax()) + 1);
+    if(edarea[i] != NULL)
+      gtk_widget_set_size_request(edarea[i], w, h);
+
+  // If serving to a browser, there are no windows, but the same applies
+  present_set_size(w, h);
+}
+
+void draw_hit_layer(cairo_t ** cr, const DRAWPARS * const drawpars)
+{
+  if(drawpars->clear) draw_background(cr);
+  draw_hits(cr, drawpars);
 }
 
 void draw_event(const DRAWPARS * const drawpars)
@@ -62,49 +140,87 @@ void draw_event(const DRAWPARS * const drawpars)
   set_eventn_status();
   if(theevents.empty()) return;
 
-  if(!isfd && theevents[gevi].fdlike){
+  if(!isfd && shown_event().fdlike){
     setfd();
     request_edarea_size();
   }
 
+  perf_begin(perfframe);
+
+  present_prepare();
+
+  // A new hit layer has nothing in it, so needs a background even in the
+  // middle of an animation
+  const bool clear = prepare_hit_layers() || drawpars->clear;
+
   cairo_t * cr[kXorY];
-  for(int i = 0; i < kXorY; i++)
-    cairo_push_group(cr[i] = gdk_cairo_create(edarea[i]->window));
+  for(int i = 0; i < kXorY; i++) cr[i] = cairo_create(hitlayer[i]);
 
-  // Do not blank the display in the middle of an animation unless necessary
-  if(drawpars->clear) draw_background(cr);
+  // If the hits were drawn ahead of time, just copy them.  Otherwise, do
+  // not blank the display in the middle of an animation unless necessary.
+  perf_begin(perfbackground);
+  const bool prerendered = prerender_paint(cr, drawpars);
+  if(clear && !prerendered) draw_background(cr);
+  perf_end(perfbackground);
+
+  // Spill mode adds to what it drew before unless told that the layer was
+  // blanked
+  DRAWPARS hitpars = *drawpars;
+  hitpars.clear = clear;
 
-  draw_hits(cr, drawpars, edarea);
+  perf_begin(perfhits);
+  if(!prerendered) draw_hits(cr, &hitpars);
+  perf_end(perfhits);
 
   set_eventn_status(); // overwrite anything that draw_hits did
 
-  // Draw and save the state with hits but not reco objects so that we can easily
-  // redraw with differently highlighted things later
-  for(int i = 0; i < kXorY; i++){
-    if(eventpattern[i] != NULL) cairo_pattern_destroy(eventpattern[i]);
-    eventpattern[i] = cairo_pop_group(cr[i]);
-    cairo_push_group(cr[i]);
-    cairo_set_source(cr[i], eventpattern[i]);
-    cairo_paint(cr[i]);
-  }
+  for(int i = 0; i < kXorY; i++) cairo_destroy(cr[i]);
 
-  draw_tracks(cr, drawpars);
-  draw_vertices(cr, drawpars);
+  compose_damage_all(comphits);
+  compose_views(drawpars);
 
-  for(int i = 0; i < kXorY; i++){
-    cairo_pop_group_to_source(cr[i]);
-    cairo_paint(cr[i]);
-    cairo_destroy(cr[i]);
+  perf_end(perfframe);
+
+  // Get ready for the user going to the next or previous event
+  if(drawpars->clear) prerender_schedule();
+}
+
+void recompose_event()
+{
+  if(theevents.empty()) return;
+
+  // Without the hits at the current size, there is nothing to start from
+  if(prepare_hit_layers()){
+    redraw_event(NULL, NULL, NULL);
+    return;
   }
+
+  DRAWPARS drawpars;
+  set_drawpars_current(drawpars);
+  drawpars.clear = true;
+  compose_views(&drawpars);
+}
+
+void set_drawpars_current(DRAWPARS & drawpars)
+{
+  const noeevent & E = shown_event();
+  drawpars.firsttick = E.current_mintick;
+  drawpars.lasttick  = E.current_maxtick;
+  drawpars.bytns    = E.current_by_tns;
+  drawpars.firsttns = E.current_mintns;
+  drawpars.lasttns  = E.current_maxtns;
 }
 
 gboolean redraw_event(__attribute__((unused)) GtkWidget *widg,
-                      __attribute__((unused)) GdkEventExpose * ee,
+                      GdkEventExpose * ee,
                       __attribute__((unused)) gpointer data)
 {
+  // If only the X server lost the picture, e.g. because the window was
+  // uncovered or resized without the views changing size, we have it
+  if(ee != NULL && present_repaint()) return FALSE;
+
   DRAWPARS drawpars;
-  drawpars.firsttick = theevents[gevi].current_mintick;
-  drawpars.lasttick  = theevents[gevi].current_maxtick;
+  set_drawpars_current(drawpars);
   drawpars.clear = true;
   draw_event(&drawpars);
 
@@ -3,16 +3,57 @@ struct DRAWPARS{
   // and not the whole range that is visible.
   int32_t firsttick, lasttick;
   bool clear;
+
+  // If set, select by TNS instead, drawing things with times in ns greater
+  // than firsttns and no greater than lasttns.  For animating by TNS.
+  bool bytns = false;
+  float firsttns = 0, lasttns = 0;
+
+  // Whether something at this time is in the range to draw
+  bool shows(const int32_t tdc, const float tns) const
+  {
+    if(bytns) return tns > firsttns && tns <= lasttns;
+    return tdc >= firsttick && tdc <= lasttick;
+  }
 };
 
+// Set drawpars to draw the whole range that is shown right now, by TNS if
+// an animation by TNS is under way.
+void set_drawpars_current(DRAWPARS & drawpars);
+
 // Refresh the event display in its current state.  For use when exposed.
 gboolean redraw_event(GtkWidget *widg, GdkEventExpose * ee,
                       gpointer data);
 
+// Blank the views and draw the detector boxes given, and the empty box of
+// the muon catcher in the y view if 'mu' is not NULL.  Reads no globals.
+void draw_boxes(cairo_t ** cr, const rect * const views,
+                const rect * const mu);
+
+// Draw the background (if drawpars->clear) and the hits of the current
+// event, but no reco objects
+void draw_hit_layer(cairo_t ** cr, const DRAWPARS * const drawpars);
+
 // Draw a whole event, a range, or an animation frame, as dictated by
 // the DRAWPARS.
 void draw_event(const DRAWPARS * const drawpars);
 
+// Put what changed in the event's layers (see compose.h) on the screen,
+// e.g. after something else is highlighted or a layer of reco objects is
+// turned on or off, without drawing the hits again.
+void recompose_event();
+
 // Set the size of the event display areas to the size of the detector
 // at the default zoom level
 void request_edarea_size();
+
+// Get a cairo context for drawing in view V.  This is the offscreen surface
+// if one has been set, which it is once a frame has been drawn, or else the
+// window on the screen.  Call present_views() to show what was drawn.  The
+// caller must cairo_destroy() it.
+cairo_t * view_cairo(const int V);
+
+// The size of view V in pixels, either of the window or the offscreen
+// surface.
+int view_width(const int V);
+int view_height(const int V);
@@ -0,0 +1,43 @@
+/* event.cxx: What is done to an event's hits both on reading it (see
+ * ingest.h) and on drawing it, kept in one place so that the two agree.
+ * This doesn't use GTK, so that bench/ingestbench.cxx can use it too. */
+
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "event.h"
+
+bool hit_charge_less(const hit & a, const hit & b)
+{
+  return a.adc < b.adc;
+}
+
+void sort_hits_by_charge(noeevent & E)
+{
+  if(E.hits_by_charge) return;
+  std::sort(E.hits.begin(), E.hits.end(), hit_charge_less);
+  E.hits_by_charge = true;
+}
+
+void count_hits_by_tick(noeevent & E)
+{
+  if(E.hits.empty()) return;
+  const unsigned int n = E.maxtick - E.mintick + 2;
+  if(E.tickprefix.size() == n) return;
+
+  E.tickprefix.assign(n, 0);
+  for(unsigned int i = 0; i < E.hits.size(); i++)
+    E.tickprefix[E.hits[i].tdc - E.mintick + 1]++;
+  for(unsigned int i = 1; i < n; i++)
+    E.tickprefix[i] += E.tickprefix[i-1];
+}
+
+int event_hits_in_ticks(noeevent & E, int32_t lo, int32_t hi)
+{
+  if(E.hits.empty()) return 0;
+  count_hits_by_tick(E);
+  lo = std::max(lo, E.mintick);
+  hi = std::min(hi, E.maxtick);
+  if(hi < lo) return 0;
+  return E.tickprefix[hi - E.mintick + 1] - E.tickprefix[lo - E.mintick];
+}
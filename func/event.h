@@ -2,6 +2,7 @@ struct hit{
   uint16_t cell, plane;
   int16_t adc;
   bool good_tns;
+  uint8_t slice; // 1 and up for slices, 0 for none or the noise slice
   int32_t tdc;
   float tns;
 };
@@ -28,22 +29,75 @@ struct track{
   float tns; // time in ns.  Copied from a double.
 
   std::vector<hit> hits;
+
+  // The layer, i.e. the collection the track was read from.  See layers.h.
+  uint8_t layer = 0;
+
+  // Trajectory points as read from the file: x, y, z in cm for each point,
+  // in floats to save memory.  Converting these to plane and cell space is
+  // slow enough that we only do it when the track is first drawn, filling
+  // in 'traj' and then freeing these.  See convert_reco().
+  std::vector<float> rawtraj;
   std::vector<cppoint> traj[2 /* x and y */];
 };
 
 struct vertex{
+  float rawpos[3]; // Position as read from the file, x, y, z in cm
   cppoint pos[2 /* x and y */]; // Positions in plane/cell space
   short posx, posy, posz; // Positions in real space, in integer mm
   int32_t time; // time in TDC ticks
   float tns; // time in ns.  Copied from a double.
+  uint8_t layer = 0; // as for tracks
+};
+
+// Numbers describing a whole event, for finding events without looking at
+// their hits.  See summarize_event() and query.cxx.
+struct eventsummary{
+  int32_t nhits = 0, nhitsx = 0, nhitsy = 0;
+  int64_t adcsum = 0;
+  int32_t adcmax = 0;
+  int32_t tickspan = 0; // from the first hit to the last
+  int32_t ntracks = 0, nvertices = 0, nslices = 0;
+  bool fdlike = false;
 };
 
 struct noeevent{
   std::vector<hit> hits;
+
+  // The number of slices, not counting the noise slice, and the indices into
+  // 'hits' of the hits in each slice.  Slice s's hits are slicehits[i] for
+  // slicestart[s] <= i < slicestart[s+1], in the same order as in 'hits'.
+  // Empty if no slices were read.
+  int nslices = 0;
+  std::vector<uint32_t> slicehits, slicestart;
+
+  // Indices into 'hits' in TNS order, and the earliest and latest TNS.  Only
+  // filled in when needed, for animating by TNS.  See index_hits_by_tns().
+  std::vector<uint32_t> tnsorder;
+  float mintns = 0, maxtns = 0;
+
+  // For finding the hit to draw in each cell for any range of ticks.  The
+  // hits of each cell with hits are cellorder[i] for cellstart[c] <= i <
+  // cellstart[c+1], as indices into 'hits' in time order.  Starting at
+  // cellmaxstart[c], cellmax has a sparse table of each of these lists:
+  // entry k*n + i, where n is the length of the list, is the greatest of the
+  // 2^k indices starting at i.  Since 'hits' is in charge order, that is the
+  // hit drawn on top.  Only filled in when needed.  See index_hits_by_cell().
+  std::vector<uint32_t> cellorder, cellstart, cellmax, cellmaxstart;
+
+  // The number of hits before each tick: tickprefix[i] hits have ticks less
+  // than mintick + i.  Made when the event is read.  See count_hits_by_tick().
+  std::vector<uint32_t> tickprefix;
+
   std::vector<track> tracks;
   std::vector<vertex> vertices;
   uint32_t nevent, nrun, nsubrun;
 
+  // Trigger time in ns since the epoch, or zero if not known
+  uint64_t timestamp = 0;
+
+  eventsummary summary;
+
   // The first and last hits physically in the event
   int32_t mintick = 0x7fffffff, maxtick = 0;
 
@@ -68,8 +122,23 @@ struct noeevent{
   // or not.
   int32_t current_mintick = 0x7fffffff, current_maxtick = 0;
 
+  // While animating by TNS, the range being displayed is instead given
+  // in ns, as hits with TNS greater than current_mintns and no greater than
+  // current_maxtns.  The ticks are then kept roughly in step.
+  bool current_by_tns = false;
+  float current_mintns = 0, current_maxtns = 0;
+
   bool fdlike = false;
 
+  // Whether 'hits' has been sorted by charge, which is the order they are
+  // drawn in so that the most important ones end up on top.  Done once, on
+  // reading the event, after which hit indices don't change.
+  bool hits_by_charge = false;
+
+  // Whether the tracks' 'traj' and the vertices' 'pos' have been filled in
+  // from their raw positions yet.
+  bool reco_converted = false;
+
   void addtrack(const track & t)
   {
     tracks.push_back(t);
@@ -93,3 +162,23 @@ struct noeevent{
     if(h.tdc > maxtick) current_maxtick = user_maxtick = maxtick = h.tdc;
   }
 };
+
+// Fill in the plane and cell space positions of the event's tracks and
+// vertices from their raw positions, unless that has already been done.
+// This needs the geometry, so it is defined in the art module.  It is
+// called when the reconstructed objects are first drawn so that reading
+// events the user never looks at doesn't pay for it.
+void convert_reco(noeevent & ev);
+
+// Whether hit a is drawn before hit b, i.e. has less charge, so that the
+// most important hits end up on top
+bool hit_charge_less(const hit & a, const hit & b);
+
+// Sort the event's hits by charge, unless already done.  See event.cxx.
+void sort_hits_by_charge(noeevent & E);
+
+// Fill in E.tickprefix, unless already done
+void count_hits_by_tick(noeevent & E);
+
+// The number of E's hits with ticks from lo through hi, in constant time
+int event_hits_in_ticks(noeevent & E, int32_t lo, int32_t hi);
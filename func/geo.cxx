@@ -97,43 +97,76 @@ void setfd()
 // that the left/top of the first plane/cell is.
 int screenxoffset = 0, screenyoffset_xview = 0, screenyoffset_yview = 0;
 
-int det_to_screen_x(const int plane)
+screenparams current_screenparams()
+{
+  screenparams sp;
+  sp.pixx = pixx;
+  sp.pixy = pixy;
+  sp.xoffset = screenxoffset;
+  sp.yoffset[kX] = screenyoffset_xview;
+  sp.yoffset[kY] = screenyoffset_yview;
+  sp.first_mucatcher = first_mucatcher;
+  sp.ncells_perplane = ncells_perplane;
+  return sp;
+}
+
+int det_to_screen_x(const screenparams & sp, const int plane)
 {
   const bool xview = plane%2 == 1;
   return 1 + // Don't overdraw the border
-    pixx*((plane
+    sp.pixx*((plane
 
          // space out the muon catcher planes so they are twice as far
          // apart as normal.  This is very close to right, since the depth
          // of (two scintillator planes + one steel plane + air gaps) is
          // within 10% of the depth of two scintillator planes.
-         +(plane > first_mucatcher?plane-first_mucatcher:0))/2)
+         +(plane > sp.first_mucatcher?plane-sp.first_mucatcher:0))/2)
 
         // stagger x and y planes
-      + xview*pixx/2
+      + xview*sp.pixx/2
+
+      - sp.xoffset;
+}
 
-      - screenxoffset;
+int det_to_screen_x(const int plane)
+{
+  return det_to_screen_x(current_screenparams(), plane);
 }
 
 // XXX put in the extra space between extrusions.
-int det_to_screen_y(const int plane, const int cell)
+int det_to_screen_y(const screenparams & sp, const int plane, const int cell)
 {
   const bool xview = plane%2 == 1;
 
   // In each view, every other plane is offset by half a cell width
   const bool celldown = !((plane/2)%2 ^ (plane%2));
 
-  return + pixy*(ncells_perplane-cell) // cells numbered from the bottom
+  return + sp.pixy*(sp.ncells_perplane-cell) // cells numbered from the bottom
 
-         - (pixy-1)
+         - (sp.pixy-1)
 
          // Physical stagger of planes in each view, but not in the muon
          // catcher, which is a better approximation to the current MC
          // geometry and plausible from visual inspection of the real
          // muon catcher.
-         + (plane < first_mucatcher)*celldown*pixy/2
+         + (plane < sp.first_mucatcher)*celldown*sp.pixy/2
 
-         - (xview?screenyoffset_xview:screenyoffset_yview);
+         - sp.yoffset[xview?kX:kY];
+}
+
+int det_to_screen_y(const int plane, const int cell)
+{
+  return det_to_screen_y(current_screenparams(), plane, cell);
+}
+
+int pan_x()
+{
+  return screenxoffset;
+}
+
+int pan_y(const noe_view_t V)
+{
+  return V == kX? screenyoffset_xview: screenyoffset_yview;
 }
 
 std::pair<int, int> cppoint_to_screen(const cppoint & tp)
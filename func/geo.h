@@ -5,6 +5,14 @@ struct rect{
   int xsize, ysize;
   int ymax(){ return ymin + ysize; }
   int xmax(){ return xmin + xsize; }
+
+  // True if this rectangle and 'o' share any pixels
+  bool overlaps(const rect & o) const
+  {
+    return xsize > 0 && ysize > 0 && o.xsize > 0 && o.ysize > 0 &&
+           xmin < o.xmin + o.xsize && o.xmin < xmin + xsize &&
+           ymin < o.ymin + o.ysize && o.ymin < ymin + ysize;
+  }
 };
 
 // Given the number of pixels used for the vertical extent of a hit in one
@@ -33,14 +41,34 @@ int total_y_pixels(const int pixels_y);
 // scintillator.  This is about 0.42 of the input.
 int scintpix_from_pixx(const int x);
 
+// A copy of everything det_to_screen_x/y need to know about the current
+// zoom and pan, so that hits can be placed on screen without reading the
+// globals, i.e. from another thread.
+struct screenparams{
+  int pixx, pixy;
+  int xoffset, yoffset[kXorY];
+  int first_mucatcher, ncells_perplane;
+};
+
+// Return the screenparams for the view as it is now.
+screenparams current_screenparams();
+
 // Given the plane and cell, return the top of the screen position in
 // Cairo coordinates.  More precisely, returns half a pixel above the top.
 int det_to_screen_y(const int plane, const int cell);
+int det_to_screen_y(const screenparams & sp, const int plane, const int cell);
 
 // Given the plane, returns the left side of the screen position in Cairo
 // coordinates.  More precisely, returns half a pixel to the left of the left
 // side.
 int det_to_screen_x(const int plane);
+int det_to_screen_x(const screenparams & sp, const int plane);
+
+// How far panning has moved the views to the left and, for view V, up, in
+// pixels.  det_to_screen_x/y subtract these, so adding them back gives a
+// position that only changes on zooming.
+int pan_x();
+int pan_y(const noe_view_t V);
 
 // Given a point in fractional cell and plane coordinates, return the coordinates
 // in pixels.  The view is inferred from the plane number.
@@ -3,23 +3,73 @@
 #include <algorithm>
 #include <stdint.h>
 #include "event.h"
-#include "drawing.h"
 #include "geo.h"
+#include "drawing.h"
+#include "hits.h"
 #include "status.h"
+#include "perf.h"
+#include "merge.h"
 
 extern std::vector<noeevent> theevents;
 extern int gevi;
 extern int pixx, pixy;
 extern int active_plane, active_cell;
+extern int active_slice;
+extern bool isolate_slice, color_slices;
 
-static bool by_charge(const hit & a, const hit & b)
+__attribute__((unused)) static bool by_time(const hit & a, const hit & b)
 {
-  return a.adc < b.adc;
+  return a.tdc < b.tdc;
 }
 
-__attribute__((unused)) static bool by_time(const hit & a, const hit & b)
+// The event whose TNS index is being made or searched
+static const noeevent * tnsindexing = NULL;
+
+static bool by_tns(const uint32_t a, const uint32_t b)
 {
-  return a.tdc < b.tdc;
+  return tnsindexing->hits[a].tns < tnsindexing->hits[b].tns;
+}
+
+static bool before_tns(const float t, const uint32_t i)
+{
+  return t < tnsindexing->hits[i].tns;
+}
+
+// The event whose cell index is being made or searched
+static const noeevent * cellindexing = NULL;
+
+static bool by_cell_and_time(const uint32_t a, const uint32_t b)
+{
+  const hit & ha = cellindexing->hits[a], & hb = cellindexing->hits[b];
+  if(ha.plane != hb.plane) return ha.plane < hb.plane;
+  if(ha.cell  != hb.cell)  return ha.cell  < hb.cell;
+  return ha.tdc < hb.tdc;
+}
+
+static bool tdc_before(const uint32_t i, const int32_t t)
+{
+  return cellindexing->hits[i].tdc < t;
+}
+
+static bool before_tdc(const int32_t t, const uint32_t i)
+{
+  return t < cellindexing->hits[i].tdc;
+}
+
+// Brighten a hit while trying to retain some of its original color, but
+// just make it white if that is what it takes to make a difference.
+static void brighten(float & red, float & green, float & blue)
+{
+  const float goal = 1.3;
+  const float left = 3 - red - blue - green;
+  if(left < goal){
+    red = blue = green = 1;
+  }
+  else{
+    red += goal*(1 - red)/left;
+    blue += goal*(1 - blue)/left;
+    green += goal*(1 - green)/left;
+  }
 }
 
 // Given a hit energy, set red, green and blue to the color we want to display
@@ -46,42 +96,83 @@ static void colorhit(const int32_t adc, float & red, float & green, float & blue
                       blue = 0;
   else red = 1, green = blue  = 0;
 
-  // Brighten this hit while trying to retain some of its original color, but
-  // just make it white if that is what it takes to make a difference.
-  if(active){
-    const float goal = 1.3;
-    const float left = 3 - red - blue - green;
-    if(left < goal){
-      red = blue = green = 1;
-    }
-    else{
-      red += goal*(1 - red)/left;
-      blue += goal*(1 - blue)/left;
-      green += goal*(1 - green)/left;
+  if(active) brighten(red, green, blue);
+}
+
+// Like colorhit(), but give each slice its own hue, with more charge being
+// brighter.  Hits in no slice are gray.
+static void colorsliced(const int32_t adc, const int slice, float & red,
+                        float & green, float & blue, const bool active)
+{
+  const float value = 0.35 + 0.65*std::min(1.0f, adc/600.0f);
+  if(slice == 0){
+    red = green = blue = 0.6*value;
+  }
+  else{
+    // Step around the color wheel by the golden ratio so that slices with
+    // nearby numbers get quite different hues
+    const float hue = 6*(slice*0.618034f - (int)(slice*0.618034f));
+    const int sector = (int)hue;
+    const float f = hue - sector, lo = 0.2*value;
+    const float rise = lo + (value - lo)*f, fall = value - (value - lo)*f;
+    switch(sector){
+      case 0:  red = value, green = rise,  blue = lo;    break;
+      case 1:  red = fall,  green = value, blue = lo;    break;
+      case 2:  red = lo,    green = value, blue = rise;  break;
+      case 3:  red = lo,    green = fall,  blue = value; break;
+      case 4:  red = rise,  green = lo,    blue = value; break;
+      default: red = value, green = lo,    blue = fall;  break;
     }
   }
+
+  if(active) brighten(red, green, blue);
+}
+
+hitstyle current_hitstyle()
+{
+  hitstyle style;
+  style.sp = current_screenparams();
+  for(int v = 0; v < kXorY; v++){
+    style.width [v] = view_width ((noe_view_t)v);
+    style.height[v] = view_height((noe_view_t)v);
+  }
+  style.active_slice = active_slice;
+  style.isolate_slice = isolate_slice;
+  style.color_slices = color_slices;
+  return style;
 }
 
-// Draw a single hit to the screen, taking into account whether it is the
-// "active" hit (i.e. being moused over right now).
-void draw_hit(cairo_t * cr, const hit & thishit, GtkWidget ** edarea)
+// Draw a single hit to the screen, brightened if it is "active", i.e. being
+// moused over right now.  Reads nothing but its arguments.
+bool draw_hit_styled(cairo_t * cr, const hit & thishit,
+                     const hitstyle & style, const bool active)
 {
   const noe_view_t V = thishit.plane%2 == 1?kX:kY;
+  const int pixx = style.sp.pixx, pixy = style.sp.pixy;
+
+  const bool inslice = style.active_slice > 0 &&
+                       thishit.slice == style.active_slice;
+  if(style.isolate_slice && style.active_slice > 0 && !inslice) return false;
 
   // Get position of upper left corner.  If the zoom carries this hit entirely
   // out of the view in screen y, don't waste cycles displaying it.
-  const int screenx = det_to_screen_x(thishit.plane);
-  if(screenx+pixx < 0) return;
-  if(screenx      > edarea[V]->allocation.width) return;
+  const int screenx = det_to_screen_x(style.sp, thishit.plane);
+  if(screenx+pixx < 0) return false;
+  if(screenx      > style.width[V]) return false;
 
-  const int screeny = det_to_screen_y(thishit.plane, thishit.cell);
-  if(screeny+pixy < 0) return;
-  if(screeny      > edarea[V]->allocation.height) return;
+  const int screeny = det_to_screen_y(style.sp, thishit.plane, thishit.cell);
+  if(screeny+pixy < 0) return false;
+  if(screeny      > style.height[V]) return false;
 
   float red, green, blue;
 
-  colorhit(thishit.adc, red, green, blue,
-           thishit.plane == active_plane && thishit.cell == active_cell);
+  // Hits in the chosen slice are brightened the same way as the hit under
+  // the mouse
+  if(style.color_slices)
+    colorsliced(thishit.adc, thishit.slice, red, green, blue,
+                inslice || active);
+  else
+    colorhit(thishit.adc, red, green, blue, inslice || active);
 
   cairo_set_source_rgb(cr, red, green, blue);
 
@@ -115,33 +206,282 @@ void draw_hit(cairo_t * cr, const hit & thishit, GtkWidget ** edarea)
                         epixx-1,     pixy-1);
   }
   cairo_stroke(cr);
+  return true;
 }
 
+bool draw_hit(cairo_t * cr, const hit & thishit, const bool active)
+{
+  return draw_hit_styled(cr, thishit, current_hitstyle(), active);
+}
 
-// Draw all the hits in the event that we need to draw, depending on
-// whether we are animating or have been exposed, etc.
-void draw_hits(cairo_t ** cr, const DRAWPARS * const drawpars, GtkWidget ** edarea)
+// The position of the given cell in E's cell index, or -1 if it has no
+// hits.  The cells are in plane and cell order, so this is a binary search.
+static int find_cell(const noeevent & E, const int plane, const int cell)
 {
-  for(int i = 0; i < kXorY; i++) cairo_set_line_width(cr[i], 1.0);
+  unsigned int lo = 0, hi = E.cellstart.size() - 1;
+  while(lo < hi){
+    const unsigned int mid = (lo + hi)/2;
+    const hit & h = E.hits[E.cellorder[E.cellstart[mid]]];
+    if(h.plane < plane || (h.plane == plane && h.cell < cell)) lo = mid + 1;
+    else                                                        hi = mid;
+  }
+  if(lo + 1 >= E.cellstart.size()) return -1;
+  const hit & h = E.hits[E.cellorder[E.cellstart[lo]]];
+  return h.plane == plane && h.cell == cell? lo: -1;
+}
+
+void draw_active_cell(cairo_t ** cr, const DRAWPARS * const drawpars)
+{
+  if(active_plane < 0 || active_cell < 0) return;
+
+  // Only the hit on top shows.  Spill mode keeps track of which that is.
+  if(merge_count() > 1){
+    const hit * const top = merged_top_hit(active_plane, active_cell);
+    if(top != NULL) draw_hit(cr[top->plane%2 == 1?kX:kY], *top, true);
+    return;
+  }
+
+  // Otherwise it is the last in charge order, as when drawing the event
+  noeevent & E = theevents[gevi];
+  index_hits_by_cell(E);
+  const int c = find_cell(E, active_plane, active_cell);
+  if(c < 0) return;
+
+  int64_t top = -1;
+  for(unsigned int i = E.cellstart[c]; i < E.cellstart[c+1]; i++){
+    const hit & h = E.hits[E.cellorder[i]];
+    if(isolate_slice && active_slice > 0 && h.slice != active_slice)
+      continue;
+    if(drawpars->shows(h.tdc, h.tns))
+      top = std::max(top, (int64_t)E.cellorder[i]);
+  }
+
+  if(top >= 0) draw_hit(cr[E.hits[top].plane%2 == 1?kX:kY], E.hits[top], true);
+}
+
+rect cell_box(const int plane, const int cell)
+{
+  rect r;
+  r.xmin = det_to_screen_x(plane);
+  r.ymin = det_to_screen_y(plane, cell);
+  r.xsize = pixx + 1;
+  r.ysize = pixy + 1;
+  return r;
+}
 
-  std::vector<hit> & THEhits = theevents[gevi].hits;
+void draw_slice_hits(cairo_t ** cr, const int slice,
+                     const DRAWPARS * const drawpars)
+{
+  const noeevent & E = theevents[gevi];
+  if(slice <= 0 || slice > E.nslices) return;
+
+  const hitstyle style = current_hitstyle();
+  int ndrawn = 0, nculled = 0;
+  for(unsigned int i = E.slicestart[slice]; i < E.slicestart[slice+1]; i++){
+    const hit & thishit = E.hits[E.slicehits[i]];
+
+    if(!drawpars->shows(thishit.tdc, thishit.tns)) continue;
+
+    if(draw_hit_styled(cr[thishit.plane%2 == 1?kX:kY], thishit, style, false))
+      ndrawn++;
+    else
+      nculled++;
+  }
 
-  std::sort(THEhits.begin(), THEhits.end(), by_charge);
+  perf_hits(ndrawn, nculled);
+}
 
-  const int big = 100000;
-  const bool bigevent = THEhits.size() > big;
+void index_hits_by_tns(noeevent & E)
+{
+  if(E.tnsorder.size() == E.hits.size()) return;
 
-  int ndrawn = 0;
-  for(unsigned int i = 0; i < THEhits.size(); i++){
-    const hit & thishit = THEhits[i];
+  // The index refers to hits by position, so fix their order first
+  sort_hits_by_charge(E);
 
-    if(thishit.tdc < drawpars->firsttick ||
-       thishit.tdc > drawpars->lasttick) continue;
+  E.tnsorder.resize(E.hits.size());
+  for(unsigned int i = 0; i < E.hits.size(); i++) E.tnsorder[i] = i;
+  tnsindexing = &E;
+  std::sort(E.tnsorder.begin(), E.tnsorder.end(), by_tns);
 
-    if(bigevent && (++ndrawn)%big == 0)
-      set_eventn_status_progress(ndrawn, THEhits.size());
+  E.mintns = E.hits[E.tnsorder.front()].tns;
+  E.maxtns = E.hits[E.tnsorder.back()].tns;
+}
 
-    draw_hit(cr[thishit.plane%2 == 1?kX:kY], thishit, edarea);
+// Draw the hits in the TNS range of drawpars, found by binary search in the
+// TNS index instead of by looking at every hit.  Since the hits are stored
+// in charge order, drawing the ones found in index order keeps the most
+// important ones on top.
+static void draw_hits_by_tns(cairo_t ** cr, const DRAWPARS * const drawpars)
+{
+  noeevent & E = theevents[gevi];
+  index_hits_by_tns(E);
+  tnsindexing = &E;
+
+  const std::vector<uint32_t>::iterator first =
+    std::upper_bound(E.tnsorder.begin(), E.tnsorder.end(),
+                     drawpars->firsttns, before_tns);
+  const std::vector<uint32_t>::iterator last =
+    std::upper_bound(first, E.tnsorder.end(), drawpars->lasttns, before_tns);
+
+  // Kept between frames to avoid allocating for each one
+  static std::vector<uint32_t> window;
+  window.assign(first, last);
+  std::sort(window.begin(), window.end());
+
+  const hitstyle style = current_hitstyle();
+  int ndrawn = 0, nculled = 0;
+  for(unsigned int i = 0; i < window.size(); i++){
+    const hit & thishit = E.hits[window[i]];
+    if(draw_hit_styled(cr[thishit.plane%2 == 1?kX:kY], thishit, style, false))
+      ndrawn++;
+    else
+      nculled++;
   }
+
+  perf_hits(ndrawn, nculled);
+}
+
+void index_hits_by_cell(noeevent & E)
+{
+  if(!E.cellstart.empty()) return;
+
+  // The index refers to hits by position, so fix their order first
+  sort_hits_by_charge(E);
+
+  const unsigned int n = E.hits.size();
+  E.cellorder.resize(n);
+  for(unsigned int i = 0; i < n; i++) E.cellorder[i] = i;
+  cellindexing = &E;
+  std::sort(E.cellorder.begin(), E.cellorder.end(), by_cell_and_time);
+
+  for(unsigned int i = 0; i < n; i++){
+    const hit & h = E.hits[E.cellorder[i]];
+    if(i == 0 || h.plane != E.hits[E.cellorder[i-1]].plane
+              || h.cell  != E.hits[E.cellorder[i-1]].cell)
+      E.cellstart.push_back(i);
+  }
+  E.cellstart.push_back(n);
+
+  // Level 0 of each table is the list itself.  Each level after that is
+  // made from two overlapping entries of the one before.  Entries that
+  // would run off the end of the list are left as zero and never read.
+  E.cellmaxstart.resize(E.cellstart.size() - 1);
+  for(unsigned int c = 0; c + 1 < E.cellstart.size(); c++){
+    const unsigned int len = E.cellstart[c+1] - E.cellstart[c];
+    int nlevels = 1;
+    while((2u << (nlevels-1)) <= len) nlevels++;
+
+    const unsigned int base = E.cellmaxstart[c] = E.cellmax.size();
+    E.cellmax.resize(base + nlevels*len, 0);
+    for(unsigned int i = 0; i < len; i++)
+      E.cellmax[base + i] = E.cellorder[E.cellstart[c] + i];
+    for(int k = 1; k < nlevels; k++){
+      const unsigned int half = 1u << (k-1);
+      uint32_t * const prev = &E.cellmax[base + (k-1)*len];
+      uint32_t * const cur  = &E.cellmax[base + k*len];
+      for(unsigned int i = 0; i + 2*half <= len; i++)
+        cur[i] = std::max(prev[i], prev[i + half]);
+    }
+  }
+}
+
+// The index of the hit to draw in the c'th cell of the cell index for the
+// ticks [t0, t1], or -1 if it has no hits then.  The event must be in
+// cellindexing.
+static int64_t top_hit_in_cell(const unsigned int c, const int32_t t0,
+                               const int32_t t1)
+{
+  const noeevent & E = *cellindexing;
+  const uint32_t * const list = &E.cellorder[E.cellstart[c]];
+  const unsigned int len = E.cellstart[c+1] - E.cellstart[c];
+
+  const unsigned int lo =
+    std::lower_bound(list, list + len, t0, tdc_before) - list;
+  const unsigned int hi =
+    std::upper_bound(list + lo, list + len, t1, before_tdc) - list;
+  if(lo >= hi) return -1;
+
+  // Two entries of the table, possibly overlapping, cover [lo, hi)
+  const int k = 31 - __builtin_clz(hi - lo);
+  const uint32_t * const level = &E.cellmax[E.cellmaxstart[c] + k*len];
+  return std::max(level[lo], level[hi - (1u << k)]);
+}
+
+// Draw the hits in the tick range of drawpars by visiting each cell once,
+// drawing only the hit in it that would end up on top.  The time this takes
+// depends on the number of cells with hits, not on the size of the range,
+// so any change of range can be drawn quickly, even for a busy event.
+static void draw_hits_by_cell(cairo_t ** cr, const DRAWPARS * const drawpars)
+{
+  noeevent & E = theevents[gevi];
+  index_hits_by_cell(E);
+  cellindexing = &E;
+
+  // Kept between frames to avoid allocating for each one
+  static std::vector<uint32_t> tops;
+  tops.clear();
+  for(unsigned int c = 0; c + 1 < E.cellstart.size(); c++){
+    const int64_t top =
+      top_hit_in_cell(c, drawpars->firsttick, drawpars->lasttick);
+    if(top >= 0) tops.push_back(top);
+  }
+
+  // Cells don't overlap on the screen, but keep to charge order anyway
+  std::sort(tops.begin(), tops.end());
+
+  const unsigned int big = 100000;
+  const bool bigevent = tops.size() > big;
+
+  const hitstyle style = current_hitstyle();
+  int ndrawn = 0, nculled = 0;
+  for(unsigned int i = 0; i < tops.size(); i++){
+    if(bigevent && (i+1)%big == 0)
+      set_eventn_status_progress(i+1, tops.size());
+
+    const hit & thishit = E.hits[tops[i]];
+    if(draw_hit_styled(cr[thishit.plane%2 == 1?kX:kY], thishit, style, false))
+      ndrawn++;
+    else
+      nculled++;
+  }
+
+  perf_hits(ndrawn, nculled);
+}
+
+void free_hit_indices(noeevent & E)
+{
+  std::vector<uint32_t>().swap(E.tnsorder);
+  std::vector<uint32_t>().swap(E.cellorder);
+  std::vector<uint32_t>().swap(E.cellstart);
+  std::vector<uint32_t>().swap(E.cellmax);
+  std::vector<uint32_t>().swap(E.cellmaxstart);
+}
+
+// Draw all the hits in the event that we need to draw, depending on
+// whether we are animating or have been exposed, etc.
+void draw_hits(cairo_t ** cr, const DRAWPARS * const drawpars)
+{
+  if(merge_count() > 1){
+    draw_merged_hits(cr, drawpars);
+    return;
+  }
+
+  for(int i = 0; i < kXorY; i++) cairo_set_line_width(cr[i], 1.0);
+
+  sort_hits_by_charge(theevents[gevi]);
+
+  if(drawpars->bytns){
+    draw_hits_by_tns(cr, drawpars);
+    return;
+  }
+
+  // Don't look at hits that aren't going to be drawn
+  if(isolate_slice && active_slice > 0 &&
+     active_slice <= theevents[gevi].nslices){
+    draw_slice_hits(cr, active_slice, drawpars);
+    return;
+  }
+
+  draw_hits_by_cell(cr, drawpars);
 }
 
@@ -1,2 +1,41 @@
-void draw_hit(cairo_t * cr, const hit & thishit, GtkWidget ** edarea);
-void draw_hits(cairo_t ** cr, const DRAWPARS * const drawpars, GtkWidget ** edarea);
+// Everything about the view that decides where and how a hit is drawn.
+// Only ints, so two can be compared with memcmp once zeroed.
+struct hitstyle{
+  screenparams sp;
+  int width[kXorY], height[kXorY];
+  int active_slice, isolate_slice, color_slices;
+};
+
+// Return the hitstyle for the view as it is now.
+hitstyle current_hitstyle();
+
+// As draw_hit(), but taking the view from 'style' instead of the globals,
+// so that it can be used off the main thread.
+bool draw_hit_styled(cairo_t * cr, const hit & thishit,
+                     const hitstyle & style, const bool active);
+
+// Draw a hit, returning false if it was not drawn because it is off screen.
+// If 'active' is set, it is brightened as the hit under the mouse pointer.
+bool draw_hit(cairo_t * cr, const hit & thishit, const bool active = false);
+
+// Draw the hits of the cell under the mouse pointer that are in the range
+// of drawpars, brightened
+void draw_active_cell(cairo_t ** cr, const DRAWPARS * const drawpars);
+
+// The area of the screen taken up by the given cell
+rect cell_box(const int plane, const int cell);
+void draw_hits(cairo_t ** cr, const DRAWPARS * const drawpars);
+
+// Draw only the hits in the given slice of the current event, within the
+// time range in drawpars
+void draw_slice_hits(cairo_t ** cr, const int slice,
+                     const DRAWPARS * const drawpars);
+
+// Fill in the event's TNS index, unless already done
+void index_hits_by_tns(noeevent & E);
+
+// Fill in the event's index of hits by cell and time, unless already done
+void index_hits_by_cell(noeevent & E);
+
+// Free the event's TNS and cell indices.  They are made again if needed.
+void free_hit_indices(noeevent & E);
@@ -0,0 +1,347 @@
+// Conversion of art reconstruction objects into NOE's own structures.
+//
+// This is used by the art module, but doesn't depend on art itself.  The
+// functions are templates on the art types so that the same code can be
+// run on stand-ins for them, as in bench/ingestbench.cxx.  The types must
+// provide the parts of the interfaces of rb::CellHit, rb::Track, rb::Vertex,
+// rb::Cluster and art::ServiceHandle<geo::Geometry> that are used here, and
+// the geo namespace must provide View_t, kX, kY and PlaneGeo.
+//
+// Since this has static data, include it in only one file of a program.
+
+static std::vector< std::vector<float> > xcell_z;
+static std::vector< std::vector<float> > ycell_z;
+static std::vector<float> xplane_z;
+static std::vector<float> yplane_z;
+static std::vector< std::vector<float> > xcell_x;
+static std::vector< std::vector<float> > ycell_y;
+
+// Given a position in 3-space, return a plane and cell that is reasonably
+// close in the given view assuming a regular detector geometry.
+static cppoint get_int_plane_and_cell(
+  const double x, const double y, const double z, const geo::View_t view)
+{
+  cppoint ans;
+
+  // (1) First the plane
+  {
+    std::vector<float> & tplane_z = view == geo::kX?xplane_z:yplane_z;
+
+    const std::vector<float>::iterator pi
+      = std::upper_bound(tplane_z.begin(), tplane_z.end(), z);
+
+    const int add = (view == geo::kX);
+
+    if(pi == tplane_z.end()){
+      // No plane had as big a 'z' as this, so use the last plane.
+      ans.plane = (tplane_z.size()-1) * 2 + add;
+    }
+    else if(pi == tplane_z.begin()){
+      // 'z' was smaller than the first plane, so that's the closest.
+      ans.plane = add;
+    }
+    else{
+      // Check which is closer, the first plane bigger than 'z', or the
+      // previous one.
+      const float thisone  = fabs( *pi - z);
+      const float previous = fabs( *(pi - 1) - z);
+      if(thisone < previous) ans.plane = (pi - tplane_z.begin())*2 + add;
+      else                   ans.plane = (pi - tplane_z.begin())*2 + add - 2;
+    }
+  }
+
+  // (2) Now find the cell
+  {
+    std::vector<float> & cells = (view == geo::kX? xcell_x:ycell_y)[ans.plane/2];
+
+    const float t = (view == geo::kX? x: y);
+    const std::vector<float>::iterator ci
+      = std::upper_bound(cells.begin(), cells.end(), t);
+
+    if(ci == cells.end()){
+      // No cell had as big a 't' as this, so use the last cell.
+      ans.cell = cells.size()-1;
+    }
+    else if(ci == cells.begin()){
+      // 't' was smaller than the first cell, so that's the closest.
+      ans.cell = 0;
+    }
+    else{
+      // Check which is closer
+      const float thisone  = fabs( *ci - t);
+      const float previous = fabs( *(ci - 1) - t);
+      if(thisone < previous) ans.cell = (ci - cells.begin());
+      else                   ans.cell = (ci - cells.begin()) - 1;
+    }
+  }
+
+  return ans;
+}
+
+template<class Geo>
+static void build_cell_lookup_table(Geo & geo)
+{
+  for(unsigned int pl = 0; pl < geo->NPlanes(); pl++){
+    const geo::PlaneGeo * const plane = geo->Plane(pl);
+    geo::View_t view;
+    std::vector<float> cell_z, cell_t;
+    for(unsigned int ce = 0; ce < plane->Ncells(); ce++){
+      double cellcenter[3], dum[3];
+      geo->CellInfo(pl, ce, &view, cellcenter, dum);
+      cell_z.push_back(cellcenter[2]);
+      cell_t.push_back(geo::kX?cellcenter[0]:cellcenter[1]);
+    }
+
+    (view == geo::kX?xcell_z:ycell_z).push_back(cell_z);
+    (view == geo::kX?xcell_x:ycell_y).push_back(cell_t);
+
+    std::vector<float> & pz = (view == geo::kX?xplane_z:yplane_z);
+    pz.push_back(cell_z[cell_z.size()/2]);
+  }
+}
+
+// Given a Cartesian position in cm, representing a track point, return the
+// position in floating-point plane and cell number for both views where an
+// integer means the cell center.
+template<class Geo>
+static std::pair<cppoint, cppoint> cart_to_cp(Geo & geo,
+  const double x, const double y, const double z)
+{
+  // With this lookup table (which isn't really a lookup table), finding
+  // track point used ~15% of the time spent loading events when it was
+  // done for every event on read-in.  Now it is done only for events that
+  // are drawn, see convert_reco().
+  {
+    static int first = true;
+    if(first) build_cell_lookup_table(geo);
+    first = false;
+  }
+
+  // For each view, first find a plane and cell which is probably the closest
+  // one, or maybe one of the several closest. Then ask the geometry where that
+  // cell is and store the difference in the fractional part of the cppoint.
+  // This is right up to the difference between the mean plane and cell
+  // spacings and the actual spacing near the requested point.  For purposes of
+  // the event display, it's fine.
+
+  // Exact values are not very important
+  const double meanplanesep = 6.6681604;
+  const double meancellsep  = 3.9674375;
+
+  std::pair<cppoint, cppoint> answer;
+  answer.first = get_int_plane_and_cell(x, y, z, geo::kX);
+
+  double cellcenter[3], dum[3];
+  geo::View_t dumv;
+
+  geo->CellInfo(answer.first.plane, answer.first.cell, &dumv, cellcenter, dum);
+  answer.first.fcell  = (x - cellcenter[0])/meancellsep;
+  answer.first.fplane = (z - cellcenter[2])/meanplanesep;
+
+  // Could optimize this by only checking the nearest two planes to the one
+  // found above, but I bet that geo::CellInfo is the hot spot, not
+  // std::upper_bound.
+  answer.second = get_int_plane_and_cell(x, y, z, geo::kY);
+
+  geo->CellInfo(answer.second.plane, answer.second.cell, &dumv, cellcenter, dum);
+  answer.second.fcell =  (y - cellcenter[1])/meancellsep;
+  answer.second.fplane = (z - cellcenter[2])/meanplanesep;
+
+  return answer;
+}
+
+// Convert an rb::CellHit
+template<class CellHit>
+static hit hit_from_cellhit(const CellHit & c)
+{
+  hit thehit;
+  thehit.cell = c.Cell();
+  thehit.plane = c.Plane();
+  thehit.adc = c.ADC();
+  thehit.tdc = c.TDC();
+  thehit.tns = c.TNS();
+  thehit.good_tns = c.GoodTiming();
+  thehit.slice = 0; // see fill_slices()
+  return thehit;
+}
+
+// Convert an rb::Track.  Only the raw trajectory points are stored.  See
+// convert_reco_with_geo().
+template<class Track>
+static track track_from_rbtrack(const Track & t)
+{
+  track thetrack;
+  thetrack.startx = 10*t.Start().X();
+  thetrack.starty = 10*t.Start().Y();
+  thetrack.startz = 10*t.Start().Z();
+  thetrack.stopx  = 10*t.Stop ().X();
+  thetrack.stopy  = 10*t.Stop ().Y();
+  thetrack.stopz  = 10*t.Stop ().Z();
+  thetrack.tns  = t.MeanTNS();
+  thetrack.time = t.MeanTNS()/1000*64.; // translate to TDC
+  thetrack.hits.reserve(t.NCell());
+  for(unsigned int c = 0; c < t.NCell(); c++){
+    hit thehit;
+    thehit.cell = t.Cell(c)->Cell();
+    thehit.plane = t.Cell(c)->Plane();
+    thehit.slice = 0;
+    thetrack.hits.push_back(thehit);
+  }
+
+  // Just store the positions here.  Converting them to plane and cell
+  // is put off until the track is drawn.  See convert_reco().
+  thetrack.rawtraj.reserve(3*t.NTrajectoryPoints());
+  for(unsigned int p = 0; p < t.NTrajectoryPoints(); p++){
+    const auto & tp = t.TrajectoryPoint(p);
+    thetrack.rawtraj.push_back(tp.X());
+    thetrack.rawtraj.push_back(tp.Y());
+    thetrack.rawtraj.push_back(tp.Z());
+  }
+  return thetrack;
+}
+
+// Convert an rb::Vertex, again only storing the raw position
+template<class Vertex>
+static vertex vertex_from_rbvertex(const Vertex & v)
+{
+  vertex thevertex;
+  thevertex.rawpos[0] = v.GetX();
+  thevertex.rawpos[1] = v.GetY();
+  thevertex.rawpos[2] = v.GetZ();
+  thevertex.posx  = 10*v.GetX();
+  thevertex.posy  = 10*v.GetY();
+  thevertex.posz  = 10*v.GetZ();
+  thevertex.tns  = v.GetT();
+  thevertex.time = v.GetT()/1000*64; // translate to TDC
+  return thevertex;
+}
+
+// Add the cell hits to 'ev'
+template<class CellHits>
+static void fill_event(noeevent & ev, const CellHits & cellhits)
+{
+  ev.hits.reserve(cellhits.size());
+  for(unsigned int i = 0; i < cellhits.size(); i++)
+    ev.addhit(hit_from_cellhit(cellhits[i]));
+}
+
+// Add a collection of tracks to 'ev', to be drawn in the given layer
+template<class Tracks>
+static void add_tracks(noeevent & ev, const Tracks & tracks, const int layer)
+{
+  for(unsigned int i = 0; i < tracks.size(); i++){
+    ev.addtrack(track_from_rbtrack(tracks[i]));
+    ev.tracks.back().layer = layer;
+  }
+}
+
+// Add a collection of vertices to 'ev', to be drawn in the given layer
+template<class Vertices>
+static void add_vertices(noeevent & ev, const Vertices & vertices,
+                         const int layer)
+{
+  for(unsigned int i = 0; i < vertices.size(); i++){
+    ev.addvertex(vertex_from_rbvertex(vertices[i]));
+    ev.vertices.back().layer = layer;
+  }
+}
+
+// Fill in the plane and cell space positions of the event's reco from the
+// raw positions.  This is the body of convert_reco().
+template<class Geo>
+static void convert_reco_with_geo(Geo & geo, noeevent & ev)
+{
+  for(unsigned int i = 0; i < ev.tracks.size(); i++){
+    track & tr = ev.tracks[i];
+    for(int v = 0; v < 2; v++) tr.traj[v].reserve(tr.rawtraj.size()/3);
+    for(unsigned int p = 0; p+2 < tr.rawtraj.size(); p += 3){
+      const std::pair<cppoint, cppoint> tps = cart_to_cp(geo,
+        tr.rawtraj[p], tr.rawtraj[p+1], tr.rawtraj[p+2]);
+      tr.traj[geo::kX].push_back(tps.first);
+      tr.traj[geo::kY].push_back(tps.second);
+    }
+
+    // Not needed again, and as big as the converted points
+    std::vector<float>().swap(tr.rawtraj);
+  }
+
+  for(unsigned int i = 0; i < ev.vertices.size(); i++){
+    vertex & vert = ev.vertices[i];
+    const std::pair<cppoint, cppoint> cp = cart_to_cp(geo,
+      vert.rawpos[0], vert.rawpos[1], vert.rawpos[2]);
+    vert.pos[0] = cp.first;
+    vert.pos[1] = cp.second;
+  }
+}
+
+// Mark each hit of 'ev' with the slice it is in.  Must be called after
+// fill_event() and before index_hits(), while ev.hits is in the same order
+// as the cell hits.  'hitsid' is the art product ID of the cell hits; slices
+// made from other cell hits are skipped.  The noise slice is not counted as
+// a slice, and only the first 255 are kept, with a warning if there are more.
+template<class Slices, class ProductID>
+static void fill_slices(noeevent & ev, const Slices & slices,
+                        const ProductID & hitsid)
+{
+  int n = 0, ndropped = 0;
+  for(unsigned int s = 0; s < slices.size(); s++){
+    if(slices[s].IsNoise()) continue;
+    if(n == 255){
+      ndropped++;
+      continue;
+    }
+    n++;
+    for(unsigned int c = 0; c < slices[s].NCell(); c++)
+      if(slices[s].Cell(c).id() == hitsid &&
+         slices[s].Cell(c).key() < ev.hits.size())
+        ev.hits[slices[s].Cell(c).key()].slice = n;
+  }
+  ev.nslices = n;
+
+  if(ndropped > 0)
+    fprintf(stderr, "Warning: Event %u has %d slices, but NOE can only show "
+      "255.  The rest are not shown.\n", ev.nevent, n + ndropped);
+}
+
+// Fill in ev.summary.  Call after everything else has been read.
+static void summarize_event(noeevent & ev)
+{
+  eventsummary & s = ev.summary;
+  s = eventsummary();
+  s.nhits = ev.hits.size();
+  for(unsigned int i = 0; i < ev.hits.size(); i++){
+    const hit & h = ev.hits[i];
+    if(h.plane%2 == 1) s.nhitsx++;
+    else               s.nhitsy++;
+    s.adcsum += h.adc;
+    s.adcmax = std::max(s.adcmax, (int32_t)h.adc);
+  }
+  s.tickspan = ev.hits.empty()? 0: ev.maxtick - ev.mintick;
+  s.ntracks = ev.tracks.size();
+  s.nvertices = ev.vertices.size();
+  s.nslices = ev.nslices;
+  s.fdlike = ev.fdlike;
+}
+
+// Put the hits in the order they are drawn, by charge so that the most
+// important ones end up on top, and make the per-slice lists of hits.  This
+// is done once here so that hit indices don't change afterwards.
+static void index_hits(noeevent & ev)
+{
+  sort_hits_by_charge(ev);
+  count_hits_by_tick(ev);
+
+  if(ev.nslices == 0) return;
+
+  // Counting sort by slice, which keeps charge order within each slice
+  ev.slicestart.assign(ev.nslices + 2, 0);
+  for(unsigned int i = 0; i < ev.hits.size(); i++)
+    ev.slicestart[ev.hits[i].slice + 1]++;
+  for(int s = 0; s <= ev.nslices; s++)
+    ev.slicestart[s+1] += ev.slicestart[s];
+
+  std::vector<uint32_t> next(ev.slicestart.begin(), ev.slicestart.end() - 1);
+  ev.slicehits.resize(ev.hits.size());
+  for(unsigned int i = 0; i < ev.hits.size(); i++)
+    ev.slicehits[next[ev.hits[i].slice]++] = i;
+}
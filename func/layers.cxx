@@ -0,0 +1,315 @@
+/* layers.cxx: Collections of reconstructed objects as layers.  For each
+ * view, each collection of tracks or vertices read from the file is drawn
+ * into a surface of its own, which is kept until something that changes
+ * how it looks does, e.g. the event, zoom, pan or times shown.  The frame
+ * is the hits with the enabled layers painted on top (see compose.cxx), so
+ * turning a collection on or off draws nothing again but the layer being
+ * turned on, and that only if it is out of date.
+ *
+ * The highlighted track and vertex are left out of the layers and drawn on
+ * top of them.  When they change, only the areas they cover are drawn
+ * again.  When an animation adds to the times shown, only the objects that
+ * come into view are drawn, on top of what is already there. */
+
+#include <gtk/gtk.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "event.h"
+#include "geo.h"
+#include "drawing.h"
+#include "active.h"
+#include "tracks.h"
+#include "vertices.h"
+#include "perf.h"
+#include "layers.h"
+#include "compose.h"
+
+extern std::vector<noeevent> theevents;
+extern int gevi;
+extern bool isfd;
+extern int pixx, pixy;
+extern int active_track, active_vertex;
+extern std::vector<screentrack_t> screentracks[kXorY];
+extern std::vector<screenvertex_t> screenvertices[kXorY];
+
+// Everything that the drawing of a layer depends on
+struct layerkey{
+  int evi;
+  int pixx, pixy, isfd;
+  int xoffset, yoffset[kXorY];
+  int32_t firsttick, lasttick;
+  int bytns;
+  float firsttns, lasttns;
+};
+
+struct layer{
+  std::string label;
+  bool tracks; // otherwise vertices
+  bool enabled;
+
+  // The drawing of each view, and what it was drawn for.  'drawn' is false
+  // if there isn't one.
+  cairo_surface_t * surface[kXorY];
+  int width[kXorY], height[kXorY];
+  bool drawn;
+  layerkey key;
+
+  // The highlighted track or vertex when it was drawn, which was left out
+  int leftout;
+};
+
+static std::vector<layer> layers;
+
+// What the layers were last brought up to date for, and whether any has
+// been turned on or off since, either of which changes what can be picked
+// out with the mouse
+static layerkey lastkey;
+static bool toggled = false;
+
+int layer_add(const char * const label, const bool tracks)
+{
+  layer l;
+  l.label = label;
+  l.tracks = tracks;
+  l.enabled = true;
+  for(int V = 0; V < kXorY; V++){
+    l.surface[V] = NULL;
+    l.width[V] = l.height[V] = 0;
+  }
+  l.drawn = false;
+  memset(&l.key, 0, sizeof l.key);
+  l.leftout = -1;
+  layers.push_back(l);
+  return layers.size() - 1;
+}
+
+int layer_count()
+{
+  return layers.size();
+}
+
+const char * layer_label(const int L)
+{
+  return layers[L].label.c_str();
+}
+
+bool layer_has_tracks(const int L)
+{
+  return layers[L].tracks;
+}
+
+bool layer_enabled(const int L)
+{
+  return L >= 0 && L < (int)layers.size() && layers[L].enabled;
+}
+
+void layer_enable(const int L, const bool on)
+{
+  if(L < 0 || L >= (int)layers.size()) return;
+  if(layers[L].enabled == on) return;
+  layers[L].enabled = on;
+  toggled = true;
+  compose_damage_all(compreco);
+}
+
+static layerkey current_key(const DRAWPARS * const drawpars)
+{
+  layerkey k;
+  memset(&k, 0, sizeof k);
+  k.evi = gevi;
+  k.pixx = pixx, k.pixy = pixy, k.isfd = isfd;
+  k.xoffset = pan_x();
+  k.yoffset[kX] = pan_y(kX);
+  k.yoffset[kY] = pan_y(kY);
+  k.firsttick = drawpars->firsttick, k.lasttick = drawpars->lasttick;
+  k.bytns = drawpars->bytns;
+  k.firsttns = drawpars->firsttns, k.lasttns = drawpars->lasttns;
+  return k;
+}
+
+// Whether 'now' only shows more than 'before', at later times, so that a
+// layer drawn for 'before' can be brought up to date by drawing on top of it
+static bool extends(const layerkey & before, const layerkey & now)
+{
+  layerkey b = before;
+  b.lasttick = now.lasttick, b.lasttns = now.lasttns;
+  return !memcmp(&b, &now, sizeof b) && now.lasttick >= before.lasttick &&
+         now.lasttns >= before.lasttns;
+}
+
+// Whether the current event has anything in layer L
+static bool layer_in_event(const int L)
+{
+  const noeevent & E = theevents[gevi];
+  if(layers[L].tracks){
+    for(unsigned int i = 0; i < E.tracks.size(); i++)
+      if(E.tracks[i].layer == L) return true;
+  }
+  else{
+    for(unsigned int i = 0; i < E.vertices.size(); i++)
+      if(E.vertices[i].layer == L) return true;
+  }
+  return false;
+}
+
+// Make the layer's surfaces match the size of the views, keeping the ones
+// that already do.  Made like the surfaces the views draw to, but with
+// transparency.
+static void prepare_surfaces(layer & l)
+{
+  for(int V = 0; V < kXorY; V++){
+    const int w = std::max(1, view_width(V)), h = std::max(1, view_height(V));
+    if(l.surface[V] != NULL && l.width[V] == w && l.height[V] == h) continue;
+
+    if(l.surface[V] != NULL) cairo_surface_destroy(l.surface[V]);
+    cairo_t * cr = view_cairo(V);
+    l.surface[V] = cairo_surface_create_similar(cairo_get_target(cr),
+                                              CAIRO_CONTENT_COLOR_ALPHA, w, h);
+    cairo_destroy(cr);
+    l.width[V] = w, l.height[V] = h;
+    l.drawn = false;
+  }
+}
+
+// Draw the reco objects of layer L in the range of drawpars into its
+// surfaces, first blanking them if drawpars->clear is set
+static void render(const int L, const DRAWPARS * const drawpars)
+{
+  layer & l = layers[L];
+  cairo_t * cr[kXorY];
+  for(int V = 0; V < kXorY; V++){
+    cr[V] = cairo_create(l.surface[V]);
+    if(!drawpars->clear) continue;
+    cairo_set_operator(cr[V], CAIRO_OPERATOR_CLEAR);
+    cairo_paint(cr[V]);
+    cairo_set_operator(cr[V], CAIRO_OPERATOR_OVER);
+  }
+
+  if(l.tracks){
+    perf_begin(perftracks);
+    draw_tracks(cr, drawpars, L);
+    perf_end(perftracks);
+  }
+  else{
+    perf_begin(perfvertices);
+    draw_vertices(cr, drawpars, L);
+    perf_end(perfvertices);
+  }
+
+  for(int V = 0; V < kXorY; V++) cairo_destroy(cr[V]);
+}
+
+// The area of view V covered by object i of layer L, if it is shown there
+static bool object_box(const int L, const int V, const int i, rect & box)
+{
+  const noeevent & E = theevents[gevi];
+  if(layers[L].tracks){
+    if(i < 0 || i >= (int)screentracks[V].size() ||
+       E.tracks[i].layer != L || !screentracks[V][i].shown) return false;
+    box = screentracks[V][i].box;
+  }
+  else{
+    if(i < 0 || i >= (int)screenvertices[V].size() ||
+       E.vertices[i].layer != L || !screenvertices[V][i].shown) return false;
+    box = screenvertices[V][i].box;
+  }
+  return true;
+}
+
+// Draw layer L again where object i of it is, if anywhere, to put it in or
+// take it out
+static void render_object(const int L, const int i)
+{
+  layer & l = layers[L];
+  for(int V = 0; V < kXorY; V++){
+    rect r;
+    if(!object_box(L, V, i, r)) continue;
+
+    cairo_t * cr = cairo_create(l.surface[V]);
+    cairo_rectangle(cr, r.xmin, r.ymin, r.xsize, r.ysize);
+    cairo_clip(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(cr);
+    cairo_set_operator(cr, CAIRO_OPERATOR_OVER);
+    if(l.tracks) redraw_tracks(cr, V, r, L);
+    else         redraw_vertices(cr, V, r, L);
+    cairo_destroy(cr);
+
+    compose_damage(compreco, V, r);
+  }
+}
+
+// Make the highlighted object 'active' the one left out of layer L, putting
+// back the one left out before
+static void leave_out(const int L, const int active)
+{
+  const int before = layers[L].leftout;
+  if(before == active) return;
+  layers[L].leftout = active;
+  render_object(L, before);
+  render_object(L, active);
+}
+
+bool update_layers(const DRAWPARS * const drawpars)
+{
+  const layerkey key = current_key(drawpars);
+  bool changed = toggled || memcmp(&key, &lastkey, sizeof key);
+
+  // Drawing a layer places all reco objects on the screen again, so a layer
+  // drawn before something else was shown can't be kept
+  if(changed && !extends(lastkey, key))
+    for(unsigned int L = 0; L < layers.size(); L++) layers[L].drawn = false;
+
+  toggled = false;
+  lastkey = key;
+
+  for(unsigned int L = 0; L < layers.size(); L++){
+    layer & l = layers[L];
+    if(!l.enabled || !layer_in_event(L)) continue;
+
+    const int active = l.tracks? active_track: active_vertex;
+
+    // Up to date except maybe for what is highlighted
+    prepare_surfaces(l);
+    if(l.drawn && !memcmp(&key, &l.key, sizeof key)){
+      leave_out(L, active);
+      continue;
+    }
+
+    // Just the objects coming into view, or everything.  An animation
+    // changes the hits everywhere anyway, so the whole view is noted as
+    // changed either way.
+    DRAWPARS pars = *drawpars;
+    if(l.drawn && extends(l.key, key)){
+      pars.clear = false;
+      if(pars.bytns) pars.firsttns  = l.key.lasttns;
+      else           pars.firsttick = l.key.lasttick + 1;
+    }
+    else{
+      pars.clear = true;
+    }
+    render(L, &pars);
+    compose_damage_all(compreco);
+    if(pars.clear) l.leftout = active;
+    else           leave_out(L, active);
+
+    l.key = key;
+    l.drawn = true;
+    changed = true;
+  }
+  return changed;
+}
+
+void paint_layers(cairo_t ** cr)
+{
+  for(unsigned int L = 0; L < layers.size(); L++){
+    const layer & l = layers[L];
+    if(!l.enabled || !l.drawn || !layer_in_event(L)) continue;
+    for(int V = 0; V < kXorY; V++){
+      cairo_set_source_surface(cr[V], l.surface[V], 0, 0);
+      cairo_paint(cr[V]);
+    }
+  }
+}
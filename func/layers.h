@@ -0,0 +1,28 @@
+// Collections of tracks and vertices, each drawn in a layer of its own
+// that the user can turn on and off.  The 'layer' of each track and vertex
+// is the number of the layer for its collection.
+
+// Add a layer for the collection with the given art label, of tracks if
+// 'tracks' is set and otherwise of vertices.  Returns its number.  Layers
+// start out enabled.
+int layer_add(const char * const label, const bool tracks);
+
+int layer_count();
+const char * layer_label(const int L);
+bool layer_has_tracks(const int L);
+
+// Whether layer L is shown.  False if there is no such layer.
+bool layer_enabled(const int L);
+void layer_enable(const int L, const bool on);
+
+// Bring the enabled layers up to date for showing the reco objects in the
+// range of 'drawpars', leaving out the highlighted track and vertex.  Layers
+// are drawn again only if something that changes how they look has changed
+// since they were last drawn, and then only as much as changed, which is
+// noted with compose_damage().  Returns true if which objects are shown
+// where might have changed, so that the caller must call
+// index_screentracks() and index_screenvertices().
+bool update_layers(const DRAWPARS * const drawpars);
+
+// Paint the enabled layers on top of the views
+void paint_layers(cairo_t ** cr);
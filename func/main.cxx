@@ -30,18 +30,8 @@ Code style:
 
 TODO:
 
-* Ticky box for enabling/disabling tracks on the fly.
-
 * Use time of tracks for animations.
 
-* Animate by TNS times instead of TDC.  Be able to switch between?
-
-* Show slices somehow. Probably will implement by having a way to show
-any kind of rb::Clusters, specified in the fcl, and defaulting to the
-standard slicer.
-
-* Allow applying time window to all events -- useful for spills.
-
 */
 
 #include <gtk/gtk.h>
@@ -52,16 +42,27 @@ standard slicer.
 #include <math.h>
 #include <algorithm>
 #include <string.h>
-#include "drawing.h"
 #include "absgeo.h"
 #include "event.h"
 #include "geo.h"
+#include "drawing.h"
 #include "tracks.h"
 #include "vertices.h"
 #include "hits.h"
 #include "status.h"
 #include "zoompan.h"
 #include "active.h"
+#include "perf.h"
+#include "trace.h"
+#include "replay.h"
+#include "present.h"
+#include "serve.h"
+#include "merge.h"
+#include "query.h"
+#include "timeline.h"
+#include "prefetch.h"
+#include "layers.h"
+#include "compose.h"
 
 // Let's see.  I believe both detectors read out in increments of 4 TDC units,
 // but the FD is multiplexed whereas the ND isn't, so any given channel at the
@@ -71,12 +72,26 @@ standard slicer.
 // TDCSTEP != 1
 static int TDCSTEP = 4;
 
+// The step of an animation by TNS, in ns.  Unlike TDCSTEP, this can be
+// less than a tick, showing the order of hits that have the same TDC.
+static float TNSSTEP = 500;
+
 /* The events and the current event index in the vector */
 extern std::vector<noeevent> theevents;
 int gevi = 0;
 
 int active_plane = -1, active_cell = -1, active_track = -1, active_vertex = -1;
 
+// The slice whose hits are highlighted, counting from 1, or 0 for none,
+// whether hits in other slices are hidden, and whether hits are colored by
+// slice instead of by charge
+int active_slice = 0;
+bool isolate_slice = false;
+bool color_slices = false;
+
+extern std::vector<screentrack_t> screentracks[kXorY];
+extern std::vector<screenvertex_t> screenvertices[kXorY];
+
 extern int first_mucatcher, ncells_perplane;
 extern int nplanes;
 
@@ -90,17 +105,25 @@ extern cairo_pattern_t * eventpattern[kXorY];
 static GtkWidget * mainwin = NULL, * trackwin = NULL, * vertexwin = NULL;
 static GtkWidget * animate_checkbox = NULL,
                  * cum_ani_checkbox = NULL,
-                 * freerun_checkbox = NULL;
+                 * freerun_checkbox = NULL,
+                 * isolate_checkbox = NULL,
+                 * slicecolor_checkbox = NULL,
+                 * tns_checkbox = NULL;
 static GtkWidget * ueventbut = NULL;
 static GtkWidget * ueventbox = NULL;
+static GtkWidget * querybox = NULL;
+static GtkWidget * timeline = NULL;
 static GtkWidget * mintickslider = NULL;
 static GtkWidget * maxtickslider = NULL;
 static GtkObject * speedadj = NULL;
+static GtkObject * mergeadj = NULL;
+static GtkObject * sliceadj = NULL;
 
 /* Running flags.  */
 bool ghave_read_all = false;
 static bool prefetching = false;
 static bool adjusttick_callback_inhibit = false; // XXX ug
+static bool adjustslice_callback_inhibit = false;
 
 /* Ticky boxes flags */
 // Animate must start false, because the first thing that happens is that we
@@ -112,6 +135,10 @@ static bool adjusttick_callback_inhibit = false; // XXX ug
 static bool animate = false;
 static bool cumulative_animation = true;
 static bool free_running = false;
+static bool animate_by_tns = false;
+
+// When serving to a browser, there is no GTK, just a GLib main loop
+static GMainLoop * headlessloop = NULL;
 
 static gulong freeruninterval = 0; // ms.  Immediately overwritten.
 static gulong animationinterval = 0; // ms.  Immediately overwritten.
@@ -119,67 +146,52 @@ static gulong freeruntimeoutid = 0;
 static gulong animatetimeoutid = 0;
 static gulong statmsgtimeoutid = 0;
 
-// Unhighlight the reconstructed objects that are no longer being moused over
-// (if any) and highlight the new ones (if any).
-static void change_highlighted_reco()
+// Leave the main loop, e.g. to read another event from art
+static void main_loop_quit()
 {
-  // You can't just overdraw a track because it doesn't light up precise
-  // rows of pixels. The way Cairo works, you end up with a thicker
-  // track with bits of both colors in it. XXX This doesn't quite work
-  // right with animations.  If a track is highlighted and then there's
-  // an animation step, the bits-of-both-colors problem still appears.
-  // But this is a pretty minor problem.
-  cairo_t * cr[kXorY];
-  for(int i = 0; i < kXorY; i++){
-    cairo_push_group(cr[i] = gdk_cairo_create(edarea[i]->window));
-    cairo_set_source(cr[i], eventpattern[i]);
-    cairo_paint(cr[i]);
-  }
-
-  DRAWPARS drawpars;
-  drawpars.firsttick = theevents[gevi].current_mintick;
-  drawpars.lasttick  = theevents[gevi].current_maxtick;
-  drawpars.clear = true;
-  draw_tracks(cr, &drawpars);
-  draw_vertices(cr, &drawpars);
+  if(headlessloop != NULL) g_main_loop_quit(headlessloop);
+  else                     gtk_main_quit();
+}
 
-  for(int i = 0; i < kXorY; i++){
-    cairo_pop_group_to_source(cr[i]);
-    cairo_paint(cr[i]);
-    cairo_destroy(cr[i]);
-  }
+static bool main_loop_events_pending()
+{
+  if(headlessloop != NULL) return g_main_context_pending(NULL);
+  else                     return gtk_events_pending();
 }
 
-// Unhighlight the cell that is no longer being moused over, indicated by
-// oldactive_plane/cell, and highlight the new one.  Do this instead of a full
-// redraw of edarea, which is expensive and causes very noticeable lag for the
-// FD.
-static void change_highlighted_cell(const int oldactive_plane,
-                                    const int oldactive_cell)
+// Highlight the hits of the newly chosen slice and unhighlight those of
+// oldslice.  Only the hits of those two slices are drawn, into the saved
+// picture of the hits, which is then put back on the screen with the other
+// layers on top.
+static void change_highlighted_slice(const int oldslice)
 {
-  cairo_t * cr[kXorY];
-  for(int i = 0; i < kXorY; i++){
-    cr[i] = gdk_cairo_create(edarea[i]->window);
-    cairo_set_line_width(cr[i], 1.0);
+  // Hiding or unhiding hits needs the background, too
+  if(isolate_slice || merge_count() > 1 || eventpattern[kX] == NULL){
+    redraw_event(NULL, NULL, NULL);
+    return;
   }
 
-  std::vector<hit> & THEhits = theevents[gevi].hits;
+  trace_begin("change_highlighted_slice");
+  DRAWPARS drawpars;
+  set_drawpars_current(drawpars);
+  drawpars.clear = false;
 
-  // We may need to find any number of hits since more than one hit
-  // can be in the same cell.  It is not guaranteed that the same hit
-  // ends up visible, but I'm just going to live with that.
-  for(unsigned int i = 0; i < THEhits.size(); i++){
-    hit & thishit = THEhits[i];
-    if((thishit.plane == oldactive_plane && thishit.cell == oldactive_cell) ||
-       (thishit.plane ==    active_plane && thishit.cell ==    active_cell))
-      draw_hit(cr[thishit.plane%2 == 1?kX:kY], thishit, edarea);
+  cairo_t * cr[kXorY];
+  for(int i = 0; i < kXorY; i++){
+    cairo_surface_t * hitsurface = NULL;
+    cairo_pattern_get_surface(eventpattern[i], &hitsurface);
+    cr[i] = cairo_create(hitsurface);
+    cairo_set_line_width(cr[i], 1.0);
   }
 
-  // NOTE: In principle we should redraw tracks here since we may have just
-  // stomped on some.  However, in practice the visual effect isn't very
-  // noticeable and since it's kinda a pain to do it from here, we'll skip it.
+  draw_slice_hits(cr, oldslice, &drawpars);
+  draw_slice_hits(cr, active_slice, &drawpars);
 
   for(int i = 0; i < kXorY; i++) cairo_destroy(cr[i]);
+
+  compose_damage_all(comphits);
+  recompose_event();
+  trace_end("change_highlighted_slice");
 }
 
 void update_active_objects(const noe_view_t V, const int x, const int y)
@@ -189,13 +201,14 @@ void update_active_objects(const noe_view_t V, const int x, const int y)
   const int oldactive_track = active_track;
   const int oldactive_vertex= active_vertex;
 
+  perf_begin(perfpick);
   update_active_indices(V, x, y, TDCSTEP);
+  perf_end(perfpick);
 
-  // Change track first because it starts by redrawing all hits from a saved
-  // cairo_pattern_t.
-  if(oldactive_track != active_track || oldactive_vertex != active_vertex)
-    change_highlighted_reco();
-  change_highlighted_cell(oldactive_plane, oldactive_cell);
+  // Only what was highlighted before and what is now are drawn again
+  if(oldactive_plane != active_plane || oldactive_cell != active_cell ||
+     oldactive_track != active_track || oldactive_vertex != active_vertex)
+    recompose_event();
   set_eventn_status_hit();
   set_eventn_status_track();
   set_eventn_status_vertex();
@@ -206,6 +219,8 @@ void update_active_objects(const noe_view_t V, const int x, const int y)
 // user having to jiggle the mouse to generate a motion-notify-event.
 static gboolean pollmouseover(__attribute__((unused)) gpointer data)
 {
+  if(edarea[kX] == NULL) return TRUE; // No mouse when serving to a browser
+
   gint x, y;
   for(int i = 0; i < kXorY; i++){
     gtk_widget_get_pointer(edarea[i], &x, &y);
@@ -227,6 +242,8 @@ static gboolean mouseover(GtkWidget * widg, GdkEventMotion * gevent,
 
   const noe_view_t V = widg == edarea[kX]? kX: kY;
 
+  record_input(inmotion, V, (int)gevent->x, (int)gevent->y, gevent->state);
+
   if(gevent->state & GDK_BUTTON1_MASK){
     dopanning(V, gevent);
     return TRUE;
@@ -237,17 +254,25 @@ static gboolean mouseover(GtkWidget * widg, GdkEventMotion * gevent,
   return TRUE;
 }
 
+// Get the hit time strip redrawn when GTK next gets to it
+static void refresh_timeline()
+{
+  if(timeline != NULL) gtk_widget_queue_draw(timeline);
+}
+
 // draw_event and to_next_free_run circularly refer to each other...
 static gboolean to_next_free_run(__attribute__((unused)) gpointer data);
 
 static void draw_whole_user_event()
 {
-  theevents[gevi].current_mintick = theevents[gevi].user_mintick;
-  theevents[gevi].current_maxtick = theevents[gevi].user_maxtick;
+  noeevent & E = shown_event();
+  E.current_mintick = E.user_mintick;
+  E.current_maxtick = E.user_maxtick;
+  E.current_by_tns = false;
 
   DRAWPARS drawpars;
-  drawpars.firsttick = theevents[gevi].current_mintick;
-  drawpars.lasttick  = theevents[gevi].current_maxtick;
+  drawpars.firsttick = E.current_mintick;
+  drawpars.lasttick  = E.current_maxtick;
   drawpars.clear = true;
   draw_event(&drawpars);
 
@@ -256,14 +281,61 @@ static void draw_whole_user_event()
   pollmouseover(NULL);
 }
 
-static gboolean animation_step(__attribute__((unused)) gpointer data)
+// The range of TNS to animate over for the user's tick range.  Where that
+// is the whole event, use the times of the first and last hits, since TNS
+// can differ a little from TDC.
+static void user_tns_range(noeevent & E, float & mintns, float & maxtns)
 {
-  noeevent & E = theevents[gevi];
+  index_hits_by_tns(E);
+  mintns = E.user_mintick <= E.mintick? E.mintns: E.user_mintick*1000/64.;
+  maxtns = E.user_maxtick >= E.maxtick? E.maxtns: E.user_maxtick*1000/64.;
+}
+
+// Set up the shown event to animate by TNS if the user asked for that.  Not
+// done in spill mode, where the events are put together by tick.
+static void start_animation(noeevent & E)
+{
+  E.current_maxtick = E.current_mintick = E.user_mintick;
+  E.current_by_tns = animate_by_tns && merge_count() == 1;
+  if(!E.current_by_tns) return;
+
+  // Start just before the first hit, since ranges don't include their start
+  float mintns, maxtns;
+  user_tns_range(E, mintns, maxtns);
+  E.current_maxtns = E.current_mintns = mintns - 1;
+}
+
+// Do the next frame of an animation by TNS.  Returns whether there are more.
+static bool animation_step_tns(noeevent & E)
+{
+  float mintns, maxtns;
+  user_tns_range(E, mintns, maxtns);
 
+  DRAWPARS drawpars;
+  drawpars.clear = E.current_maxtns < mintns || !cumulative_animation;
+  drawpars.bytns = true;
+  drawpars.firsttns = E.current_maxtns;
+  drawpars.lasttns  = E.current_maxtns += TNSSTEP;
+  if(!cumulative_animation) E.current_mintns = drawpars.firsttns;
+
+  // Keep the ticks roughly in step, e.g. for anything that ignores TNS
+  E.current_maxtick = (int32_t)floor(E.current_maxtns*64/1000);
+  E.current_mintick = cumulative_animation? E.user_mintick:
+                      (int32_t)floor(E.current_mintns*64/1000);
+  drawpars.firsttick = E.current_mintick;
+  drawpars.lasttick  = E.current_maxtick;
+  draw_event(&drawpars);
+
+  return animate && E.current_maxtns < maxtns;
+}
+
+// Do the next frame of an animation by TDC.  Returns whether there are more.
+static bool animation_step_tdc(noeevent & E)
+{
   DRAWPARS drawpars;
   // Must redraw if we are just starting the animation, or if it is
   // non-cumulative, i.e. the old hits have to be re-hidden
-  drawpars.clear = E.current_maxtick == theevents[gevi].user_mintick ||
+  drawpars.clear = E.current_maxtick == E.user_mintick ||
                    !cumulative_animation;
 
   E.current_maxtick += TDCSTEP;
@@ -276,8 +348,16 @@ static gboolean animation_step(__attribute__((unused)) gpointer data)
   drawpars.lasttick  = E.current_maxtick;
   draw_event(&drawpars);
 
+  return animate && E.current_maxtick < E.user_maxtick;
+}
+
+static gboolean animation_step(__attribute__((unused)) gpointer data)
+{
+  noeevent & E = shown_event();
+
   const bool stillanimating =
-    animate && E.current_maxtick < theevents[gevi].user_maxtick;
+    E.current_by_tns? animation_step_tns(E): animation_step_tdc(E);
+  refresh_timeline();
 
   // If we are animating and free running, go directly to the next event
   // at the end of this one, not worrying about the free run delay. This
@@ -294,9 +374,11 @@ static gboolean animation_step(__attribute__((unused)) gpointer data)
   return stillanimating;
 }
 
-static gboolean handle_event()
+// Show the shown event's ticks in the spin buttons without acting on it
+static void update_tick_sliders()
 {
-  noeevent & E = theevents[gevi];
+  const noeevent & E = shown_event();
+  if(maxtickslider == NULL) return;
   adjusttick_callback_inhibit = true;
   gtk_spin_button_set_range(GTK_SPIN_BUTTON(maxtickslider), E.mintick, E.maxtick);
   gtk_spin_button_set_range(GTK_SPIN_BUTTON(mintickslider), E.mintick, E.maxtick);
@@ -305,9 +387,30 @@ static gboolean handle_event()
   gtk_widget_draw(maxtickslider, NULL);
   gtk_widget_draw(mintickslider, NULL);
   adjusttick_callback_inhibit = false;
+}
+
+// Let the slice be chosen from those of the event shown.  If the one chosen
+// before isn't in this event, none is.
+static void update_slice_slider()
+{
+  const int n = shown_event().nslices;
+  if(active_slice > n) active_slice = 0;
+  if(sliceadj == NULL) return;
+  adjustslice_callback_inhibit = true;
+  gtk_adjustment_set_upper(GTK_ADJUSTMENT(sliceadj), n);
+  gtk_adjustment_set_value(GTK_ADJUSTMENT(sliceadj), active_slice);
+  adjustslice_callback_inhibit = false;
+}
+
+static gboolean handle_event()
+{
+  noeevent & E = shown_event();
+  update_tick_sliders();
+  update_slice_slider();
+  refresh_timeline();
 
   if(animate){
-    E.current_maxtick = E.current_mintick = E.user_mintick;
+    start_animation(E);
     if(animatetimeoutid) g_source_remove(animatetimeoutid);
 
     // Do one step immediately to be responsive to the user even if the
@@ -357,7 +460,7 @@ static bool get_event(const int change)
       //
       // NOTE: Leaving the GTK loop *seems* to be OK, but I'm not clear
       // on what happens when user events arrive when we're outside.
-      gtk_main_quit();
+      main_loop_quit();
       return false;
     }
   }
@@ -371,31 +474,64 @@ static bool get_event(const int change)
   return true;
 }
 
-// Called when idle to load events into memory
-static gboolean prefetch_an_event(__attribute__((unused)) gpointer data)
+// Whether reading events now would get in the user's way
+static bool user_busy()
+{
+  return animatetimeoutid != 0 || input_idle() < 1000;
+}
+
+// The number of events read beyond the one being shown
+static int events_ahead()
+{
+  return theevents.size() - 1 - gevi;
+}
+
+// Called periodically to load events into memory.  See prefetch.cxx for how
+// many are read each time.
+static gboolean prefetch_events(__attribute__((unused)) gpointer data)
 {
   if(ghave_read_all) return FALSE; // don't call this again
 
-  if(gtk_events_pending()) return TRUE;
+  if(main_loop_events_pending()) return TRUE;
+  if(!prefetch_should_start(events_ahead(), user_busy())) return TRUE;
 
-  // exit GTK event loop to get another event from art
+  // exit GTK event loop to get more events from art
+  trace_async_begin("prefetch");
   prefetching = true;
-  gtk_main_quit();
+  prefetch_begin();
+  main_loop_quit();
   return TRUE;
 }
 
 // Why are you always preparing?  You're always preparing! Just go!
+// Events within this many of the one shown keep their hit indices, since
+// the user often steps back and forth.  Spill mode doesn't use them.
+static const int KEEPINDICES = 2;
+
+// Free the hit indices of events far from the one shown, so that they don't
+// pile up as the user looks through a file
+static void free_far_indices()
+{
+  for(int i = 0; i < (int)theevents.size(); i++)
+    if(i < gevi - KEEPINDICES || i > gevi + KEEPINDICES)
+      free_hit_indices(theevents[i]);
+}
+
 static void prepare_to_swich_events()
 {
-  active_track = active_cell = active_plane = -1;
+  active_track = active_vertex = active_cell = active_plane = -1;
+  free_far_indices();
 }
 
 // Display the next or previous event.
-static void to_next(__attribute__((unused)) GtkWidget * widget,
-                    gpointer data)
+static void to_next(GtkWidget * widget, gpointer data)
 {
   prepare_to_swich_events();
   const bool * const forward = (const bool * const)data;
+
+  // Only record clicks, not free running
+  if(widget != NULL) record_input(inclick, *forward? buttonnext: buttonprev);
+
   if(get_event((*forward)?1:-1))
     handle_event();
 }
@@ -409,8 +545,9 @@ static gboolean to_next_free_run(__attribute__((unused)) gpointer data)
   const bool atend = gevi == (int)theevents.size()-1 && ghave_read_all;
 
   if(atend){
-    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(freerun_checkbox),
-                                 FALSE);
+    if(freerun_checkbox != NULL)
+      gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(freerun_checkbox),
+                                   FALSE);
     free_running = false;
   }
   return free_running && !atend;
@@ -428,6 +565,29 @@ static bool have_event_by_number(const unsigned int n)
   return false;
 }
 
+// Display the event with the given number, which must be one that we have.
+static void show_event_by_number(const int n)
+{
+  if(n == (int)theevents[gevi].nevent) return;
+
+  const bool forward = n > (int)theevents[gevi].nevent;
+  while(n != (int)theevents[gevi].nevent)
+    // Don't go through get_event because we do *not* want to try
+    // getting more events from the file
+    gevi += (forward?1:-1);
+
+  prepare_to_swich_events();
+  handle_event();
+}
+
+// Called periodically to show recent timings, if the user asked for them.
+// Not done on every draw since updating the status line takes time itself.
+static gboolean update_perf_status(__attribute__((unused)) gpointer data)
+{
+  set_eventn_status_perf();
+  return TRUE;
+}
+
 // Blank out the fourth status line that sometimes has error messages
 static gboolean clear_error_message(__attribute__((unused)) gpointer dt)
 {
@@ -440,11 +600,14 @@ static void getuserevent()
 {
   errno = 0;
   char * endptr;
-  const int userevent =
-    strtol(gtk_entry_get_text(GTK_ENTRY(ueventbox)), &endptr, 10);
+  const char * const text = gtk_entry_get_text(GTK_ENTRY(ueventbox));
+  const int userevent = strtol(text, &endptr, 10);
 
   clear_error_message(NULL);
 
+  if(endptr != text && *endptr == '\0')
+    record_input(ingoto, userevent);
+
   if((errno == ERANGE && (userevent == INT_MAX || userevent == INT_MIN))
      || (errno != 0 && userevent == 0)
      || endptr == optarg || *endptr != '\0'
@@ -462,14 +625,31 @@ static void getuserevent()
     return;
   }
 
-  if(userevent == (int)theevents[gevi].nevent) return;
+  show_event_by_number(userevent);
+}
 
-  const bool forward = userevent > (int)theevents[gevi].nevent;
-  while(userevent != (int)theevents[gevi].nevent)
-    // Don't go through get_event because we do *not* want to try
-    // getting more events from the file
-    gevi += (forward?1:-1);
+// Go to the next event after this one that matches the query the user
+// typed, e.g. "nhits > 5000 && ntracks >= 2".  See query.h.
+static void to_next_matching()
+{
+  clear_error_message(NULL);
+
+  char err[256];
+  const char * const text = gtk_entry_get_text(GTK_ENTRY(querybox));
+  const bool valid = query_set(text, err, sizeof err);
+  const int i = valid? query_next(gevi): -1;
+  if(i < 0){
+    if(valid)
+      set_status(staterror, "No event after this one matches%s",
+                 ghave_read_all?"":". I'm still loading events.");
+    else
+      set_status(staterror, "%s", err);
+    if(statmsgtimeoutid) g_source_remove(statmsgtimeoutid);
+    statmsgtimeoutid = g_timeout_add(8e3, clear_error_message, NULL);
+    return;
+  }
 
+  gevi = i;
   prepare_to_swich_events();
   handle_event();
 }
@@ -501,11 +681,9 @@ static void start_freerun_timer()
     std::max((gulong)1, freeruninterval), to_next_free_run, NULL, NULL);
 }
 
-// Handle the user clicking the "run freely" check box.
-static void toggle_freerun(__attribute__((unused)) GtkWidget * w,
-                           __attribute__((unused)) gpointer dt)
+static void set_freerun(const bool on)
 {
-  free_running = GTK_TOGGLE_BUTTON(w)->active;
+  free_running = on;
 
   // If free running *and* animating, the animation timer will handle
   // switching to the next event.
@@ -515,43 +693,65 @@ static void toggle_freerun(__attribute__((unused)) GtkWidget * w,
   handle_event();
 }
 
-// Handle the user clicking the "cumulative animation" check box.
-static void toggle_cum_ani(GtkWidget * w,
-                           __attribute__((unused)) gpointer dt)
+// Handle the user clicking the "run freely" check box.
+static void toggle_freerun(GtkWidget * w, __attribute__((unused)) gpointer dt)
 {
-  cumulative_animation = GTK_TOGGLE_BUTTON(w)->active;
+  record_input(incheckbox, checkfreerun, GTK_TOGGLE_BUTTON(w)->active);
+  set_freerun(GTK_TOGGLE_BUTTON(w)->active);
+}
+
+static void set_cum_ani(const bool on)
+{
+  cumulative_animation = on;
 
   // If switching to cumulative, need to draw all the previous hits.  If
   // switching away, need to blank them all out.  In either case, don't wait
   // until the next animation step, because that appears laggy for the user.
   // TODO: make that actually work.
-  DRAWPARS drawpars;
+  noeevent & E = shown_event();
   if(cumulative_animation){
-    drawpars.firsttick = theevents[gevi].user_mintick;
-    drawpars.lasttick  = theevents[gevi].current_maxtick;
+    E.current_mintick = E.user_mintick;
+    if(E.current_by_tns){
+      float maxtns;
+      user_tns_range(E, E.current_mintns, maxtns);
+      E.current_mintns -= 1;
+    }
   }
   else{
-    theevents[gevi].current_mintick = theevents[gevi].current_maxtick;
-    drawpars.firsttick = theevents[gevi].current_mintick;
-    drawpars.lasttick  = theevents[gevi].current_maxtick;
+    E.current_mintick = E.current_maxtick;
+    E.current_mintns = E.current_maxtns - TNSSTEP;
   }
+
+  DRAWPARS drawpars;
+  set_drawpars_current(drawpars);
   drawpars.clear = !cumulative_animation;
   draw_event(&drawpars);
 }
 
+// Handle the user clicking the "cumulative animation" check box.
+static void toggle_cum_ani(GtkWidget * w,
+                           __attribute__((unused)) gpointer dt)
+{
+  record_input(incheckbox, checkcumulative, GTK_TOGGLE_BUTTON(w)->active);
+  set_cum_ani(GTK_TOGGLE_BUTTON(w)->active);
+}
+
+// The abstract "speed" number from the user, 1-11
+static int speednum = 6;
+
 // Convert the abstract "speed" number from the user into a delay.
-static void set_intervals(const int speednum)
+static void set_intervals(const int speed)
 {
-  freeruninterval = (int)pow(10, 6.5 - speednum/2.0);
+  freeruninterval = (int)pow(10, 6.5 - speed/2.0);
 
   // No point in trying to go faster than ~50Hz since the monitor won't
   // keep up (to say nothing of the human eye). Control speeds of 6 and
   // higher exclusively with the TDCSTEP. This has the added benefit of
   // putting several ticks on the screen at once, which makes it easier
   // to see interesting things.
-  animationinterval = std::max(20, (int)pow(10, 5.0 - speednum/2.0));
+  animationinterval = std::max(20, (int)pow(10, 5.0 - speed/2.0));
 
-  switch(speednum < 1?1:speednum > 11?11:speednum){
+  switch(speed < 1?1:speed > 11?11:speed){
     case  1: TDCSTEP =    1; break;
     case  2: TDCSTEP =    2; break;
     case  3: TDCSTEP =    4; break;
@@ -564,17 +764,25 @@ static void set_intervals(const int speednum)
     case 10: TDCSTEP =  512; break;
     case 11: TDCSTEP = 2048; break;
   }
+
+  // By TNS, the slow speeds go below one tick (15.625ns) per step
+  switch(speed < 1?1:speed > 11?11:speed){
+    case  1: TNSSTEP =  1; break;
+    case  2: TNSSTEP =  2; break;
+    case  3: TNSSTEP =  4; break;
+    case  4: TNSSTEP =  8; break;
+    default: TNSSTEP = TDCSTEP*1000/64.; break;
+  }
 }
 
-// Handle the user clicking the "animate" check box.
-static void toggle_animate(GtkWidget * w, __attribute__((unused)) gpointer dt)
+static void set_animate(const bool on)
 {
-  animate = GTK_TOGGLE_BUTTON(w)->active;
+  animate = on;
   if(animate){
     // If free running *and* animating, the animation timer will handle
     // switching to the next event.
     stop_freerun_timer();
-    set_intervals(gtk_adjustment_get_value(GTK_ADJUSTMENT(speedadj)));
+    set_intervals(speednum);
   }
   else{
     // If we stop animating, the free run timer has to take over free running
@@ -585,31 +793,40 @@ static void toggle_animate(GtkWidget * w, __attribute__((unused)) gpointer dt)
   handle_event();
 }
 
-static void restart_animation(__attribute__((unused)) GtkWidget * w,
+// Handle the user clicking the "animate" check box.
+static void toggle_animate(GtkWidget * w, __attribute__((unused)) gpointer dt)
+{
+  record_input(incheckbox, checkanimate, GTK_TOGGLE_BUTTON(w)->active);
+  set_animate(GTK_TOGGLE_BUTTON(w)->active);
+}
+
+static void restart_animation(GtkWidget * w,
                               __attribute__((unused)) gpointer d)
 {
+  // Not recorded when called internally from adjusttick()
+  if(w != NULL) record_input(inclick, buttonrestart);
+
   // Assume that if the user wants the animation restarted, then the
   // user wants animation.
   animate = true;
-  gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(animate_checkbox), TRUE);
+  if(animate_checkbox != NULL)
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(animate_checkbox), TRUE);
   handle_event();
 }
 
-// XXX redraws of tracks and vertices when you do this has an undesired
-// effect of thickening their lines.
-static void adjusttick(GtkWidget * wg, const gpointer dt)
+// Set the range of ticks to display.  Drawing any range takes about the same
+// time (see draw_hits_by_cell()), so this can follow a slider as it moves.
+static void set_ticks(const int mintick, const int maxtick)
 {
-  if(adjusttick_callback_inhibit) return;
-
-  noeevent & E = theevents[gevi];
-
-  const bool adjmax = *(bool *)dt;
+  noeevent & E = shown_event();
 
   // TODO: respond intelligently if the user gives a maximum less
   // than the minimum.  Currently does something dumb.
 
-  (adjmax? E.user_maxtick: E.user_mintick)
-    = gtk_adjustment_get_value(GTK_ADJUSTMENT(wg));
+  const bool minchanged = mintick != E.user_mintick;
+  E.user_mintick = mintick;
+  E.user_maxtick = maxtick;
+  refresh_timeline();
 
   const int32_t oldcurrent_maxtick = E.current_maxtick;
   const int32_t oldcurrent_mintick = E.current_mintick;
@@ -626,7 +843,6 @@ static void adjusttick(GtkWidget * wg, const gpointer dt)
   drawpars.clear = E.current_maxtick < oldcurrent_maxtick ||
                    E.current_mintick > oldcurrent_mintick;
 
-  // TODO can optimize this to only draw the new range
   drawpars.firsttick = E.current_mintick;
   drawpars.lasttick  = E.current_maxtick;
 
@@ -634,18 +850,34 @@ static void adjusttick(GtkWidget * wg, const gpointer dt)
   // has changed but we've finished animating, OR if the maximum has
   // changed and is now less than where we were. TODO: This could be
   // better.
-  if(animate && (!adjmax || animatetimeoutid == 0 ||
+  if(animate && (minchanged || animatetimeoutid == 0 || E.current_by_tns ||
                  oldcurrent_maxtick < E.current_maxtick))
     restart_animation(NULL, NULL);
   else
     draw_event(&drawpars);
 }
 
-// Respond to changes in the spin button for animation/free running speed
-static void adjustspeed(GtkWidget * wg,
-                        __attribute__((unused)) const gpointer dt)
+// Set the maximum (if adjmax) or minimum tick to display.
+static void set_tick(const bool adjmax, const int tick)
 {
-  set_intervals(gtk_adjustment_get_value(GTK_ADJUSTMENT(wg)));
+  const noeevent & E = shown_event();
+  set_ticks(adjmax? E.user_mintick: tick, adjmax? tick: E.user_maxtick);
+}
+
+static void adjusttick(GtkWidget * wg, const gpointer dt)
+{
+  if(adjusttick_callback_inhibit) return;
+
+  const bool adjmax = *(bool *)dt;
+  const int tick = gtk_adjustment_get_value(GTK_ADJUSTMENT(wg));
+  record_input(inslider, adjmax? slidermaxtick: slidermintick, tick);
+  set_tick(adjmax, tick);
+}
+
+static void set_speed(const int speed)
+{
+  speednum = speed;
+  set_intervals(speednum);
 
   stop_freerun_timer();
   if(free_running && !animate) start_freerun_timer();
@@ -659,6 +891,15 @@ static void adjustspeed(GtkWidget * wg,
     animatetimeoutid = 0;
 }
 
+// Respond to changes in the spin button for animation/free running speed
+static void adjustspeed(GtkWidget * wg,
+                        __attribute__((unused)) const gpointer dt)
+{
+  const int speed = gtk_adjustment_get_value(GTK_ADJUSTMENT(wg));
+  record_input(inslider, sliderspeed, speed);
+  set_speed(speed);
+}
+
 // Called when the window is resized or moved. The buttons don't redraw
 // themselves when the window is resized, so we have to get it done. I
 // don't really want to call this 100 times when a user slowly resizes a window
@@ -684,9 +925,280 @@ static void close_window()
   // We could quit gently:
   // gtk_main_quit(); exit(0);
   // But there is nothing to save, so just drop everything quickly.
+  trace_close();
   _exit(0);
 }
 
+// Show this many events, starting with the current one, as one
+static void set_merge(const int n)
+{
+  merge_set_count(n);
+  prepare_to_swich_events();
+  handle_event();
+}
+
+// Respond to changes in the spin button for the number of events to merge
+static void adjustmerge(GtkWidget * wg,
+                        __attribute__((unused)) const gpointer dt)
+{
+  const int n = gtk_adjustment_get_value(GTK_ADJUSTMENT(wg));
+  record_input(inslider, slidermerge, n);
+  set_merge(n);
+}
+
+// Highlight the hits of slice n, or none if n is 0
+static void set_slice(const int n)
+{
+  if(n == active_slice) return;
+  const int oldslice = active_slice;
+  active_slice = n;
+  change_highlighted_slice(oldslice);
+}
+
+static void adjustslice(GtkWidget * wg,
+                        __attribute__((unused)) const gpointer dt)
+{
+  if(adjustslice_callback_inhibit) return;
+  const int n = gtk_adjustment_get_value(GTK_ADJUSTMENT(wg));
+  record_input(inslider, sliderslice, n);
+  set_slice(n);
+}
+
+// Animate by TNS instead of TDC, or go back to TDC.  Takes effect by
+// restarting the animation, if there is one.
+static void set_tns(const bool on)
+{
+  animate_by_tns = on;
+  if(animate) handle_event();
+}
+
+static void toggle_tns(GtkWidget * w, __attribute__((unused)) gpointer dt)
+{
+  record_input(incheckbox, checktns, GTK_TOGGLE_BUTTON(w)->active);
+  set_tns(GTK_TOGGLE_BUTTON(w)->active);
+}
+
+// Show only the hits of the highlighted slice, or all of them
+static void set_isolate(const bool on)
+{
+  isolate_slice = on;
+  if(active_slice > 0) redraw_event(NULL, NULL, NULL);
+}
+
+static void toggle_isolate(GtkWidget * w, __attribute__((unused)) gpointer dt)
+{
+  record_input(incheckbox, checkisolate, GTK_TOGGLE_BUTTON(w)->active);
+  set_isolate(GTK_TOGGLE_BUTTON(w)->active);
+}
+
+// Color each slice's hits differently, or color all hits by charge.  Every
+// hit changes color, so the whole event is drawn again.
+static void set_slice_colors(const bool on)
+{
+  color_slices = on;
+  redraw_event(NULL, NULL, NULL);
+}
+
+static void toggle_slice_colors(GtkWidget * w,
+                                __attribute__((unused)) gpointer dt)
+{
+  record_input(incheckbox, checkslicecolor, GTK_TOGGLE_BUTTON(w)->active);
+  set_slice_colors(GTK_TOGGLE_BUTTON(w)->active);
+}
+
+// Check boxes for turning each layer of reco objects on and off
+static std::vector<GtkWidget *> layer_checkboxes;
+
+// Show or hide layer L of reco objects
+static void set_layer(const int L, const bool on)
+{
+  layer_enable(L, on);
+
+  // Nothing hidden can stay highlighted
+  if(!on && !theevents.empty()){
+    const noeevent & E = theevents[gevi];
+    if(active_track >= 0 && E.tracks[active_track].layer == L)
+      active_track = -1;
+    if(active_vertex >= 0 && E.vertices[active_vertex].layer == L)
+      active_vertex = -1;
+  }
+
+  recompose_event();
+}
+
+static void toggle_layer(GtkWidget * w, const gpointer dt)
+{
+  const int L = *(int *)dt;
+  record_input(incheckbox, checklayer + L, GTK_TOGGLE_BUTTON(w)->active);
+  set_layer(L, GTK_TOGGLE_BUTTON(w)->active);
+}
+
+// A row of check boxes, one for each layer of reco objects
+static GtkWidget * make_layerbox()
+{
+  GtkWidget * box = gtk_hbox_new(FALSE, 0);
+  for(int L = 0; L < layer_count(); L++){
+    char name[256];
+    snprintf(name, sizeof name, "%s %s",
+             layer_has_tracks(L)? "Tracks:": "Vertices:", layer_label(L));
+    GtkWidget * check = gtk_check_button_new_with_label(name);
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check), layer_enabled(L));
+    g_signal_connect(check, "toggled", G_CALLBACK(toggle_layer), new int(L));
+    gtk_box_pack_start(GTK_BOX(box), check, FALSE, FALSE, 0);
+    layer_checkboxes.push_back(check);
+  }
+  return box;
+}
+
+/**********************************************************************/
+/*                          Input replay                              */
+/**********************************************************************/
+
+// The next input to replay, once its time comes
+static inputrecord pendinginput;
+
+// Feed one recorded input to the handler that would have gotten it in the
+// recorded session.
+static void dispatch_input(const inputrecord & r)
+{
+  static bool forward = true, backward = false;
+  const noe_view_t V = r.a == kX? kX: kY;
+  switch(r.kind){
+    case inmotion: case inpress: {
+      GdkEventMotion ev;
+      memset(&ev, 0, sizeof ev);
+      ev.type = r.kind == inmotion? GDK_MOTION_NOTIFY: GDK_BUTTON_PRESS;
+      ev.window = edarea[V]->window;
+      ev.x = r.b, ev.y = r.c;
+      ev.state = r.d;
+      if(r.kind == inmotion) mouseover(edarea[V], &ev, NULL);
+      else                   mousebuttonpress(edarea[V], &ev, NULL);
+      break;
+    }
+    case inscroll: {
+      GdkEventScroll ev;
+      memset(&ev, 0, sizeof ev);
+      ev.type = GDK_SCROLL;
+      ev.window = edarea[V]->window;
+      ev.x = r.b, ev.y = r.c;
+      ev.direction = (GdkScrollDirection)r.d;
+      bool isy = V == kY;
+      dozooming(edarea[V], &ev, &isy);
+      break;
+    }
+    case inslider:
+      // Setting the value calls the handler, unless it doesn't change
+      gtk_adjustment_set_value(
+        r.a == sliderspeed? GTK_ADJUSTMENT(speedadj):
+        r.a == slidermerge? GTK_ADJUSTMENT(mergeadj):
+        r.a == sliderslice? GTK_ADJUSTMENT(sliceadj):
+        gtk_spin_button_get_adjustment(GTK_SPIN_BUTTON(
+          r.a == slidermaxtick? maxtickslider: mintickslider)), r.b);
+      break;
+    case incheckbox:
+      if(r.a >= checklayer){
+        if(r.a - checklayer < (int)layer_checkboxes.size())
+          gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(
+            layer_checkboxes[r.a - checklayer]), r.b);
+        break;
+      }
+      gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(
+        r.a == checkanimate? animate_checkbox:
+        r.a == checkcumulative? cum_ani_checkbox:
+        r.a == checkisolate? isolate_checkbox:
+        r.a == checkslicecolor? slicecolor_checkbox:
+        r.a == checktns? tns_checkbox: freerun_checkbox), r.b);
+      break;
+    case inclick:
+      if(r.a == buttonrestart) restart_animation(NULL, NULL);
+      else to_next(NULL, r.a == buttonnext? &forward: &backward);
+      break;
+    case ingoto: {
+      char buf[32];
+      snprintf(buf, sizeof buf, "%d", r.a);
+      gtk_entry_set_text(GTK_ENTRY(ueventbox), buf);
+      getuserevent();
+      break;
+    }
+  }
+}
+
+// Replay the pending input, measuring how long it takes until the result
+// is on the screen, and arrange for the next one to be replayed at the same
+// time relative to the start as it was recorded.  Falls behind, rather than
+// skipping inputs, if the program is slower than it was when recording.
+static gboolean replay_step(__attribute__((unused)) gpointer data)
+{
+  trace_begin("replay_step");
+  const double start = input_clock();
+  dispatch_input(pendinginput);
+  gdk_window_process_all_updates();
+  gdk_flush();
+  replay_latency(pendinginput.kind, input_clock() - start);
+  trace_end("replay_step");
+
+  if(!replay_next(pendinginput)){
+    replay_report();
+    close_window();
+  }
+
+  g_timeout_add(std::max(0, (int)(pendinginput.t - input_clock())),
+                replay_step, NULL);
+  return FALSE;
+}
+
+/**********************************************************************/
+/*                        Browser commands                            */
+/**********************************************************************/
+
+bool serve_command(const char * const cmd, const int v, const int x,
+                   const int y)
+{
+  static bool forward = true, backward = false;
+  const noe_view_t V = v == kY? kY: kX;
+
+  if(theevents.empty()) return true;
+
+  if     (!strcmp(cmd, "next"))       to_next(NULL, &forward);
+  else if(!strcmp(cmd, "prev"))       to_next(NULL, &backward);
+  else if(!strcmp(cmd, "hover"))      update_active_objects(V, x, y);
+  else if(!strcmp(cmd, "press") || !strcmp(cmd, "drag")){
+    GdkEventMotion ev;
+    memset(&ev, 0, sizeof ev);
+    ev.x = x, ev.y = y;
+    if(cmd[0] == 'p') mousebuttonpress(NULL, &ev, NULL);
+    else              dopanning(V, &ev);
+  }
+  else if(!strcmp(cmd, "zoomin") || !strcmp(cmd, "zoomout")){
+    GdkEventScroll ev;
+    memset(&ev, 0, sizeof ev);
+    ev.x = x, ev.y = y;
+    ev.direction = !strcmp(cmd, "zoomin")? GDK_SCROLL_UP: GDK_SCROLL_DOWN;
+    bool isy = V == kY;
+    dozooming(NULL, &ev, &isy);
+  }
+  else if(!strcmp(cmd, "ticks"))      set_ticks(x, y);
+  else if(!strcmp(cmd, "animate"))    set_animate(v);
+  else if(!strcmp(cmd, "cumulative")) set_cum_ani(v);
+  else if(!strcmp(cmd, "freerun"))    set_freerun(v);
+  else if(!strcmp(cmd, "restart"))    restart_animation(NULL, NULL);
+  else if(!strcmp(cmd, "speed"))      set_speed(std::max(1, std::min(11, v)));
+  else if(!strcmp(cmd, "merge"))      set_merge(v);
+  else if(!strcmp(cmd, "slice"))      set_slice(std::max(0,
+                                        std::min(shown_event().nslices, v)));
+  else if(!strcmp(cmd, "isolate"))    set_isolate(v);
+  else if(!strcmp(cmd, "slicecolor")) set_slice_colors(v);
+  else if(!strcmp(cmd, "tns"))        set_tns(v);
+  else if(!strcmp(cmd, "layer"))      set_layer(x, v);
+  else if(!strcmp(cmd, "goto")){
+    if(have_event_by_number(v)) show_event_by_number(v);
+    else set_status(staterror, "Event %d invalid or not available", v);
+  }
+  else return false;
+
+  return true;
+}
+
 static void openvertexwin()
 {
   gtk_widget_show_all(vertexwin);
@@ -716,9 +1228,8 @@ static GtkWidget * make_tickslider(const bool ismax)
 
 static GtkWidget * make_speedslider()
 {
-  const int initialspeednum = 6;
-  speedadj = gtk_adjustment_new (initialspeednum, 1, 11, 1, 1, 0);
-  set_intervals(initialspeednum);
+  speedadj = gtk_adjustment_new (speednum, 1, 11, 1, 1, 0);
+  set_intervals(speednum);
   g_signal_connect(speedadj, "value_changed", G_CALLBACK(adjustspeed), NULL);
 
   GtkWidget * const speedslider
@@ -728,6 +1239,31 @@ static GtkWidget * make_speedslider()
   return speedslider;
 }
 
+static GtkWidget * make_mergeslider()
+{
+  mergeadj = gtk_adjustment_new(1, 1, 1000, 1, 10, 0);
+  g_signal_connect(mergeadj, "value_changed", G_CALLBACK(adjustmerge), NULL);
+
+  GtkWidget * const mergeslider
+    = gtk_spin_button_new(GTK_ADJUSTMENT(mergeadj), 10, 0);
+  gtk_entry_set_max_length (GTK_ENTRY(mergeslider), 4);
+  gtk_entry_set_width_chars(GTK_ENTRY(mergeslider), 4);
+  return mergeslider;
+}
+
+static GtkWidget * make_sliceslider()
+{
+  // The upper end is set for each event by update_slice_slider()
+  sliceadj = gtk_adjustment_new(0, 0, 0, 1, 10, 0);
+  g_signal_connect(sliceadj, "value_changed", G_CALLBACK(adjustslice), NULL);
+
+  GtkWidget * const sliceslider
+    = gtk_spin_button_new(GTK_ADJUSTMENT(sliceadj), 10, 0);
+  gtk_entry_set_max_length (GTK_ENTRY(sliceslider), 3);
+  gtk_entry_set_width_chars(GTK_ENTRY(sliceslider), 3);
+  return sliceslider;
+}
+
 static void set_bg_color_to_main(GtkWidget * widg)
 {
   static GdkColor * color = NULL;
@@ -775,6 +1311,32 @@ static GtkWidget * make_speedlabel()
   return speedlabel;
 }
 
+static GtkWidget * make_mergelabel()
+{
+  GtkWidget * mergelabel = gtk_text_view_new();
+  GtkTextBuffer * mergelabeltext = gtk_text_buffer_new(0);
+  gtk_text_view_set_justification(GTK_TEXT_VIEW(mergelabel), GTK_JUSTIFY_RIGHT);
+  const char * const mergelabelbuf = "Events merged";
+  gtk_text_buffer_set_text(mergelabeltext, mergelabelbuf, strlen(mergelabelbuf));
+  gtk_text_view_set_buffer(GTK_TEXT_VIEW(mergelabel), mergelabeltext);
+  gtk_text_view_set_editable(GTK_TEXT_VIEW(mergelabel), false);
+  set_bg_color_to_main(mergelabel);
+  return mergelabel;
+}
+
+static GtkWidget * make_slicelabel()
+{
+  GtkWidget * slicelabel = gtk_text_view_new();
+  GtkTextBuffer * slicelabeltext = gtk_text_buffer_new(0);
+  gtk_text_view_set_justification(GTK_TEXT_VIEW(slicelabel), GTK_JUSTIFY_RIGHT);
+  const char * const slicelabelbuf = "Slice";
+  gtk_text_buffer_set_text(slicelabeltext, slicelabelbuf, strlen(slicelabelbuf));
+  gtk_text_view_set_buffer(GTK_TEXT_VIEW(slicelabel), slicelabeltext);
+  gtk_text_view_set_editable(GTK_TEXT_VIEW(slicelabel), false);
+  set_bg_color_to_main(slicelabel);
+  return slicelabel;
+}
+
 static GtkWidget * make_ueventbox()
 {
   GtkWidget * ueventbox = gtk_entry_new();
@@ -784,6 +1346,81 @@ static GtkWidget * make_ueventbox()
   return ueventbox;
 }
 
+static GtkWidget * make_querybox()
+{
+  GtkWidget * querybox = gtk_entry_new();
+  gtk_entry_set_width_chars(GTK_ENTRY(querybox), 20);
+  gtk_widget_set_tooltip_text(querybox, "Find events, e.g. "
+    "\"nhits > 5000 && ntracks >= 2\".  Can use nhits, nhitsx, nhitsy, "
+    "adcsum, adcmax, tickspan, ntracks, nvertices, nslices, fdlike, run, "
+    "subrun and event.");
+  g_signal_connect(querybox, "activate", G_CALLBACK(to_next_matching), NULL);
+  return querybox;
+}
+
+static gboolean expose_timeline(GtkWidget * w,
+                                __attribute__((unused)) GdkEventExpose * ee,
+                                __attribute__((unused)) gpointer data)
+{
+  cairo_t * cr = gdk_cairo_create(w->window);
+  draw_timeline(cr, w->allocation.width, w->allocation.height);
+  cairo_destroy(cr);
+  return FALSE;
+}
+
+// Dragging across the hit time strip selects the range of ticks to show
+static gboolean timeline_press(GtkWidget * w, GdkEventButton * ev,
+                               __attribute__((unused)) gpointer data)
+{
+  if(ev->button != 1) return FALSE;
+  timeline_select((int)ev->x, w->allocation.width, true);
+  refresh_timeline();
+  return TRUE;
+}
+
+static gboolean timeline_motion(GtkWidget * w, GdkEventMotion * ev,
+                                __attribute__((unused)) gpointer data)
+{
+  if(!(ev->state & GDK_BUTTON1_MASK)) return FALSE;
+  timeline_select((int)ev->x, w->allocation.width, false);
+  refresh_timeline();
+  return TRUE;
+}
+
+static gboolean timeline_release(__attribute__((unused)) GtkWidget * w,
+                                 __attribute__((unused)) GdkEventButton * ev,
+                                 __attribute__((unused)) gpointer data)
+{
+  int32_t lo, hi;
+  if(!timeline_end_select(lo, hi)) return FALSE;
+
+  record_input(inslider, slidermintick, lo);
+  record_input(inslider, slidermaxtick, hi);
+  set_ticks(lo, hi);
+  update_tick_sliders();
+  return TRUE;
+}
+
+static GtkWidget * make_timeline()
+{
+  GtkWidget * const strip = gtk_drawing_area_new();
+  gtk_widget_set_size_request(strip, -1, 32);
+  gtk_widget_set_tooltip_text(strip, "Hits at each time in the event.  "
+                              "Drag to choose which ticks to show.");
+  g_signal_connect(strip, "expose-event", G_CALLBACK(expose_timeline), NULL);
+  g_signal_connect(strip, "button-press-event",
+                   G_CALLBACK(timeline_press), NULL);
+  g_signal_connect(strip, "motion-notify-event",
+                   G_CALLBACK(timeline_motion), NULL);
+  g_signal_connect(strip, "button-release-event",
+                   G_CALLBACK(timeline_release), NULL);
+  gtk_widget_set_events(strip, gtk_widget_get_events(strip)
+                               | GDK_POINTER_MOTION_MASK
+                               | GDK_BUTTON_PRESS_MASK
+                               | GDK_BUTTON_RELEASE_MASK);
+  return strip;
+}
+
 static GtkWidget * make_aux_win(const char * const name, const statcontents si)
 {
   GtkWidget * w = gtk_window_new(GTK_WINDOW_TOPLEVEL);
@@ -837,6 +1474,9 @@ static void setup()
   animate_checkbox = gtk_check_button_new_with_mnemonic("_Animate");
   cum_ani_checkbox = gtk_check_button_new_with_mnemonic("_Cumulative animation");
   freerun_checkbox = gtk_check_button_new_with_mnemonic("_Free running");
+  isolate_checkbox = gtk_check_button_new_with_mnemonic("_Only this slice");
+  slicecolor_checkbox = gtk_check_button_new_with_mnemonic("Color s_lices");
+  tns_checkbox     = gtk_check_button_new_with_mnemonic("By TN_S");
 
   gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(animate_checkbox),
                                animate);
@@ -848,6 +1488,16 @@ static void setup()
   g_signal_connect(animate_checkbox, "toggled", G_CALLBACK(toggle_animate),NULL);
   g_signal_connect(cum_ani_checkbox, "toggled", G_CALLBACK(toggle_cum_ani),NULL);
   g_signal_connect(freerun_checkbox, "toggled", G_CALLBACK(toggle_freerun),NULL);
+  g_signal_connect(isolate_checkbox, "toggled", G_CALLBACK(toggle_isolate),NULL);
+  g_signal_connect(slicecolor_checkbox, "toggled",
+                   G_CALLBACK(toggle_slice_colors), NULL);
+
+  // Both slice check boxes share one place in the table
+  GtkWidget * const slicechecks = gtk_vbox_new(FALSE, 0);
+  gtk_box_pack_start(GTK_BOX(slicechecks), isolate_checkbox, TRUE, TRUE, 0);
+  gtk_box_pack_start(GTK_BOX(slicechecks), slicecolor_checkbox,
+                     TRUE, TRUE, 0);
+  g_signal_connect(tns_checkbox,     "toggled", G_CALLBACK(toggle_tns),    NULL);
 
   GtkWidget * re_an_button = gtk_button_new_with_mnemonic("_Restart animation");
   g_signal_connect(re_an_button, "clicked", G_CALLBACK(restart_animation), NULL);
@@ -858,12 +1508,20 @@ static void setup()
   GtkWidget * const minticklabel = make_ticklabel(false);
   GtkWidget * const speedslider  = make_speedslider();
   GtkWidget * const speedlabel   = make_speedlabel();
+  GtkWidget * const mergeslider  = make_mergeslider();
+  GtkWidget * const mergelabel   = make_mergelabel();
+  GtkWidget * const sliceslider  = make_sliceslider();
+  GtkWidget * const slicelabel   = make_slicelabel();
   ueventbox                      = make_ueventbox();
+  querybox                       = make_querybox();
 
   ueventbut = gtk_button_new_with_mnemonic("_Go to event");
   g_signal_connect(ueventbut, "clicked",  G_CALLBACK(getuserevent), NULL);
 
-  const int nrow = 8, ncol = 11;
+  GtkWidget * const querybut = gtk_button_new_with_mnemonic("Next _matching");
+  g_signal_connect(querybut, "clicked", G_CALLBACK(to_next_matching), NULL);
+
+  const int nrow = 10, ncol = 11;
   GtkWidget * tab = gtk_table_new(nrow, ncol, FALSE);
   gtk_container_add(GTK_CONTAINER(mainwin), tab);
 
@@ -872,8 +1530,8 @@ static void setup()
     re_an_button, freerun_checkbox, speedslider, ueventbox, ueventbut};
 
   GtkWidget * second_row_widgets[ncol] = {
-    NULL, NULL, minticklabel, maxticklabel, NULL,
-    NULL, NULL, NULL, speedlabel, NULL, NULL};
+    slicelabel, sliceslider, minticklabel, maxticklabel, slicechecks,
+    tns_checkbox, querybox, querybut, speedlabel, mergelabel, mergeslider};
 
   for(int c = 0; c < ncol; c++){
     gtk_table_attach(GTK_TABLE(tab), top_row_widgets[c], c, c+1, 0, 1,
@@ -884,15 +1542,23 @@ static void setup()
         GtkAttachOptions(GTK_EXPAND | GTK_FILL), GTK_SHRINK, 0, 0);
   }
 
+  timeline = make_timeline();
+  gtk_table_attach(GTK_TABLE(tab), timeline, 0, ncol, 2, 3,
+    GtkAttachOptions(GTK_EXPAND | GTK_FILL), GTK_SHRINK, 0, 0);
+
+  if(layer_count() > 0)
+    gtk_table_attach(GTK_TABLE(tab), make_layerbox(), 0, ncol, 3, 4,
+      GtkAttachOptions(GTK_EXPAND | GTK_FILL), GTK_SHRINK, 0, 0);
+
   for(int i = 0; i < NSTATBOXES; i++) makestatbox(i);
 
-  gtk_table_attach(GTK_TABLE(tab), statbox[statrunevent], 0, ncol-1, 2, 3,
+  gtk_table_attach(GTK_TABLE(tab), statbox[statrunevent], 0, ncol-1, 4, 5,
     GtkAttachOptions(GTK_EXPAND | GTK_FILL), GTK_SHRINK, 0, 0);
-  gtk_table_attach(GTK_TABLE(tab), statbox[stattiming],   0, ncol-1, 3, 4,
+  gtk_table_attach(GTK_TABLE(tab), statbox[stattiming],   0, ncol-1, 5, 6,
     GtkAttachOptions(GTK_EXPAND | GTK_FILL), GTK_SHRINK, 0, 0);
-  gtk_table_attach(GTK_TABLE(tab), statbox[stathit],      0, ncol-1, 4, 5,
+  gtk_table_attach(GTK_TABLE(tab), statbox[stathit],      0, ncol-1, 6, 7,
     GtkAttachOptions(GTK_EXPAND | GTK_FILL), GTK_SHRINK, 0, 0);
-  gtk_table_attach(GTK_TABLE(tab), statbox[staterror],    0, ncol-1, 5, 6,
+  gtk_table_attach(GTK_TABLE(tab), statbox[staterror],    0, ncol-1, 7, 8,
     GtkAttachOptions(GTK_EXPAND | GTK_FILL), GTK_SHRINK, 0, 0);
 
   trackwin  = make_aux_win("Tracks"  , stattrack );
@@ -904,25 +1570,29 @@ static void setup()
   GtkWidget * const vertexbut = gtk_button_new_with_mnemonic("Show _vertex info");
   g_signal_connect(vertexbut, "clicked",  G_CALLBACK(openvertexwin), NULL);
 
-  gtk_table_attach(GTK_TABLE(tab), tracksbut, ncol-1, ncol, 2, 4,
+  gtk_table_attach(GTK_TABLE(tab), tracksbut, ncol-1, ncol, 4, 6,
       GtkAttachOptions(GTK_EXPAND | GTK_FILL),
       GtkAttachOptions(GTK_EXPAND | GTK_FILL), 0, 0);
 
-  gtk_table_attach(GTK_TABLE(tab), vertexbut, ncol-1, ncol, 4, 6,
+  gtk_table_attach(GTK_TABLE(tab), vertexbut, ncol-1, ncol, 6, 8,
       GtkAttachOptions(GTK_EXPAND | GTK_FILL),
       GtkAttachOptions(GTK_EXPAND | GTK_FILL), 0, 0);
 
   for(int i = 0; i < kXorY; i++)
     gtk_table_attach(GTK_TABLE(tab), edarea[i], 0, ncol,
-                     6+2*i, 7+2*i,
+                     8+2*i, 9+2*i,
                      GtkAttachOptions(GTK_EXPAND | GTK_FILL),
                      GtkAttachOptions(GTK_EXPAND | GTK_FILL), 0, 0);
 
   gtk_table_attach(GTK_TABLE(tab), gtk_hseparator_new(), 0, ncol,
-                   7, 8,
+                   9, 10,
                    GtkAttachOptions(GTK_EXPAND | GTK_FILL),
                    GtkAttachOptions(GTK_SHRINK), 0, 0);
 
+  if(perf_enabled())
+    gtk_table_attach(GTK_TABLE(tab), statbox[statperf], 0, ncol, 12, 13,
+      GtkAttachOptions(GTK_EXPAND | GTK_FILL), GTK_SHRINK, 0, 0);
+
   // This isn't the size I want, but along with requesting the size of the
   // edarea widgets, it has the desired effect, at least more or less.
   gtk_window_set_default_size(GTK_WINDOW(mainwin), 400, 300);
@@ -941,9 +1611,38 @@ static void setup()
   // they aren't supposed to according to the spec, but all the other ones do...
   gtk_widget_queue_draw(mainwin);
 
-  if(!ghave_read_all) g_timeout_add(20, prefetch_an_event, NULL);
+  if(!ghave_read_all) g_timeout_add(20, prefetch_events, NULL);
 
   g_timeout_add(500, pollmouseover, NULL);
+
+  if(perf_enabled()) g_timeout_add(500, update_perf_status, NULL);
+
+  input_clock_start();
+  if(replay_next(pendinginput))
+    g_timeout_add(std::max(0, (int)pendinginput.t), replay_step, NULL);
+}
+
+// Instead of setup(), when serving to a browser.  There is no GTK, just a
+// GLib main loop, and drawing goes to image surfaces.
+static void setup_headless()
+{
+#if !GLIB_CHECK_VERSION(2, 36, 0)
+  g_type_init();
+#endif
+  headlessloop = g_main_loop_new(NULL, FALSE);
+  present_enable(presentserve, 8);
+  setboxes();
+  request_edarea_size();
+
+  if(!serve_start()){
+    trace_close();
+    _exit(1);
+  }
+
+  get_event(0);
+  handle_event();
+
+  if(!ghave_read_all) g_timeout_add(20, prefetch_events, NULL);
 }
 
 /*********************************************************************/
@@ -960,13 +1659,23 @@ static void setup()
 // and we will know that we should stay in the GTK event loop.
 void realmain(const bool have_read_all)
 {
+  trace_begin("realmain");
   if(have_read_all) ghave_read_all = true;
   static bool first = true;
   if(first){
     first = false;
-    setup();
+    if(serving()) setup_headless();
+    else          setup();
   }
   else if(prefetching){
+    // Go right back to art for another event if there is time
+    if(!ghave_read_all && !main_loop_events_pending() &&
+       prefetch_continue(events_ahead(), user_busy())){
+      trace_end("realmain");
+      return;
+    }
+
+    trace_async_end("prefetch");
     set_eventn_status_runevent();
     prefetching = false;
   }
@@ -974,5 +1683,12 @@ void realmain(const bool have_read_all)
     get_event(1);
     g_timeout_add(0, draw_event_from_timer, NULL);
   }
-  gtk_main();
+
+  trace_begin("gtk_main");
+  if(headlessloop != NULL) g_main_loop_run(headlessloop);
+  else                     gtk_main();
+  trace_end("gtk_main");
+
+  trace_end("realmain");
+  trace_flush();
 }
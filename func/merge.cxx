@@ -0,0 +1,210 @@
+/* merge.cxx: Spill mode, in which several consecutive events are shown as
+ * one.  Each event is shifted in time by an offset so that they fall on one
+ * timeline.  Hits are drawn without copying any of them, and as in a single
+ * event, the one with the most charge in each cell is drawn.  Events with
+ * no hits in the time window, which each event's hit counts by tick tell
+ * at once (see tickprefix in event.h), are skipped, and the hits of the rest
+ * are looked through.  The only memory this takes beyond the events
+ * themselves is a table of the hit on top in each cell of the detector, so
+ * it is the same however many events are merged.
+ *
+ * Events are placed according to their trigger times, but long stretches
+ * between them are cut down to MAXGAP, since otherwise an animation would
+ * spend almost all of its time showing nothing. */
+
+#include <gtk/gtk.h>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "event.h"
+#include "geo.h"
+#include "drawing.h"
+#include "hits.h"
+#include "merge.h"
+#include "perf.h"
+
+extern std::vector<noeevent> theevents;
+extern int gevi;
+extern int ncells_perplane;
+extern int active_slice;
+extern bool isolate_slice;
+
+// Longest time with no events that is shown, in TDC ticks
+static const int64_t MAXGAP = 640; // 10μs
+
+// How many events the user asked to merge
+static int nrequested = 1;
+
+// The events currently merged, theevents[mergefirst] onwards, and the
+// ticks added to each one's hits to put them on the merged timeline
+static int mergefirst = -1;
+static std::vector<int32_t> offsets;
+
+static noeevent merged;
+
+// The hit on top in each cell of what is drawn of the merged events, by
+// plane and cell as plane*ncells_perplane + cell, and the cells that have
+// one.  Kept from one drawing to the next, since an animation adds to what
+// is drawn, and the highlighted cell is looked up here.
+static std::vector<const hit *> topincell;
+static std::vector<uint32_t> cellsused;
+
+static void clear_tops()
+{
+  for(unsigned int i = 0; i < cellsused.size(); i++)
+    topincell[cellsused[i]] = NULL;
+  cellsused.clear();
+}
+
+void merge_set_count(const int n)
+{
+  nrequested = std::max(1, n);
+
+  // Leaving spill mode, so no event is merged
+  if(nrequested == 1){
+    mergefirst = -1;
+    offsets.clear();
+    clear_tops();
+  }
+}
+
+// The ticks of the first and last hits of E, or zero if it has none
+static int32_t first_tick(const noeevent & E)
+{
+  return E.hits.empty()? 0: E.mintick;
+}
+
+static int32_t last_tick(const noeevent & E)
+{
+  return E.hits.empty()? 0: E.maxtick;
+}
+
+// Work out the offsets of the events starting at gevi and the merged
+// event's ticks, if the user asked for a different set of events than last
+// time.
+static void update_merge()
+{
+  const int n = std::min(nrequested, (int)theevents.size() - gevi);
+  if(mergefirst == gevi && (int)offsets.size() == n) return;
+
+  clear_tops();
+  mergefirst = gevi;
+  offsets.assign(n, 0);
+
+  merged = noeevent();
+  merged.nevent  = theevents[gevi].nevent;
+  merged.nrun    = theevents[gevi].nrun;
+  merged.nsubrun = theevents[gevi].nsubrun;
+  merged.mintick = first_tick(theevents[gevi]);
+  merged.maxtick = last_tick (theevents[gevi]);
+
+  for(int k = 1; k < n; k++){
+    const noeevent & P = theevents[gevi+k-1];
+    const noeevent & E = theevents[gevi+k];
+
+    // If we don't know the trigger times, just put this event right after
+    // the previous one.  1 TDC tick is 1/64 μs.
+    const int64_t prevend = offsets[k-1] + (int64_t)last_tick(P);
+    int64_t offset = prevend + MAXGAP - first_tick(E);
+    if(P.timestamp != 0 && E.timestamp > P.timestamp)
+      offset = std::min(offset,
+        offsets[k-1] + (int64_t)(E.timestamp - P.timestamp)*64/1000);
+
+    offsets[k] = offset;
+    merged.mintick = std::min(merged.mintick, offsets[k] + first_tick(E));
+    merged.maxtick = std::max(merged.maxtick, offsets[k] + last_tick(E));
+    merged.fdlike |= E.fdlike;
+    merged.nslices = std::max(merged.nslices, E.nslices);
+  }
+  merged.fdlike |= theevents[gevi].fdlike;
+
+  // Each hit keeps its own event's slice number, so choosing slice s shows
+  // slice s of each event
+  merged.nslices = std::max(merged.nslices, theevents[gevi].nslices);
+
+  merged.user_mintick = merged.current_mintick = merged.mintick;
+  merged.user_maxtick = merged.current_maxtick = merged.maxtick;
+}
+
+int merge_count()
+{
+  if(nrequested == 1 || theevents.empty()) return 1;
+  update_merge();
+  return offsets.size();
+}
+
+int32_t merge_offset(const int k)
+{
+  if(merge_count() == 1) return 0;
+  return offsets[k];
+}
+
+noeevent & shown_event()
+{
+  if(merge_count() == 1) return theevents[gevi];
+  return merged;
+}
+
+const hit * merged_top_hit(const int plane, const int cell)
+{
+  const uint32_t c = plane*ncells_perplane + cell;
+  return c < topincell.size()? topincell[c]: NULL;
+}
+
+void draw_merged_hits(cairo_t ** cr, const DRAWPARS * const drawpars)
+{
+  for(int i = 0; i < kXorY; i++) cairo_set_line_width(cr[i], 1.0);
+
+  update_merge();
+  if(drawpars->clear) clear_tops();
+
+  // The cells whose top hit changed in this drawing.  Kept between frames
+  // to avoid allocating for each one.
+  static std::vector<uint32_t> changed;
+  changed.clear();
+
+  for(unsigned int k = 0; k < offsets.size(); k++){
+    noeevent & E = theevents[mergefirst+k];
+    sort_hits_by_charge(E);
+    const int32_t lo = drawpars->firsttick - offsets[k];
+    const int32_t hi = drawpars->lasttick  - offsets[k];
+
+    // Stop once all of the event's hits in the window have been seen
+    int left = event_hits_in_ticks(E, lo, hi);
+    for(unsigned int i = 0; left > 0 && i < E.hits.size(); i++){
+      const hit & thishit = E.hits[i];
+      if(thishit.tdc < lo || thishit.tdc > hi) continue;
+      left--;
+
+      // Hidden hits mustn't stand in for ones that would be drawn
+      if(isolate_slice && active_slice > 0 && thishit.slice != active_slice)
+        continue;
+
+      const uint32_t c = thishit.plane*ncells_perplane + thishit.cell;
+      if(c >= topincell.size()) topincell.resize(c+1, NULL);
+
+      // Ties go to the later event, as they go to the later hit in one
+      if(topincell[c] == NULL) cellsused.push_back(c);
+      else if(topincell[c]->adc > thishit.adc) continue;
+      topincell[c] = &thishit;
+      changed.push_back(c);
+    }
+  }
+
+  // A cell can change more than once, but only its last top is drawn.
+  // Cells don't overlap on the screen, so the order doesn't matter.
+  std::sort(changed.begin(), changed.end());
+  changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+
+  const hitstyle style = current_hitstyle();
+  int ndrawn = 0, nculled = 0;
+  for(unsigned int i = 0; i < changed.size(); i++){
+    const hit & thishit = *topincell[changed[i]];
+    if(draw_hit_styled(cr[thishit.plane%2 == 1?kX:kY], thishit, style, false))
+      ndrawn++;
+    else
+      nculled++;
+  }
+
+  perf_hits(ndrawn, nculled);
+}
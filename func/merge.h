@@ -0,0 +1,24 @@
+// Spill mode: show 'n' consecutive events, starting with the current one,
+// as one event on one timeline.  n = 1 turns spill mode off.
+void merge_set_count(const int n);
+
+// The number of events being shown as one right now, 1 if not in spill mode
+int merge_count();
+
+// The event whose times are being shown: theevents[gevi], or in spill mode
+// a stand-in whose tick ranges cover all the merged events.  The stand-in
+// has no hits, tracks or vertices of its own.  Since the current event is
+// the first on the merged timeline, its hits have the same ticks there.
+noeevent & shown_event();
+
+// The ticks added to the hits of the k-th merged event, counting from the
+// current one, to put them on the merged timeline.  Zero for k = 0.
+int32_t merge_offset(const int k);
+
+// Draw the hits of all merged events in the given range of merged ticks.
+// Unless drawpars->clear, this adds to what was drawn before.
+void draw_merged_hits(cairo_t ** cr, const DRAWPARS * const drawpars);
+
+// The hit drawn on top in the given cell by draw_merged_hits(), or NULL if
+// none is
+const hit * merged_top_hit(const int plane, const int cell);
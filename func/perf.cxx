@@ -0,0 +1,108 @@
+/* perf.cxx: Timers and counters for seeing where the time goes. */
+
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include "perf.h"
+#include "trace.h"
+
+static bool enabled = false;
+
+// Names of the stages in trace files
+static const char * const stagename[NPERFSTAGES] = {
+  "draw_event", "draw_background", "draw_hits", "save eventpattern",
+  "draw_tracks", "draw_vertices", "blit", "mouseover pick",
+  "convert event", "convert_reco" };
+
+// Start times of stages in progress and durations of the most recent
+// completed ones, in milliseconds.
+static double starttime[NPERFSTAGES];
+static double lasttime[NPERFSTAGES];
+
+static int lastndrawn = 0, lastnculled = 0;
+
+// Ring buffer of the durations and end times of the most recent frames
+static const int NFRAMES = 256;
+static double frametime[NFRAMES], frameend[NFRAMES];
+static int nframes = 0; // total ever, so the next index is nframes%NFRAMES
+
+static double now_ms()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e3 + ts.tv_nsec*1e-6;
+}
+
+void perf_enable(const bool on)
+{
+  enabled = on;
+}
+
+bool perf_enabled()
+{
+  return enabled;
+}
+
+void perf_begin(const perfstage s)
+{
+  if(tracing()) trace_begin(stagename[s]);
+  if(!enabled) return;
+  starttime[s] = now_ms();
+}
+
+void perf_end(const perfstage s)
+{
+  if(tracing()) trace_end(stagename[s]);
+  if(!enabled) return;
+  const double t = now_ms();
+  lasttime[s] = t - starttime[s];
+
+  if(s == perfframe){
+    frametime[nframes%NFRAMES] = lasttime[s];
+    frameend [nframes%NFRAMES] = t;
+    nframes++;
+  }
+}
+
+void perf_hits(const int ndrawn, const int nculled)
+{
+  lastndrawn = ndrawn;
+  lastnculled = nculled;
+}
+
+// Return the given quantile of the recent frame times
+static double frame_quantile(const double q)
+{
+  const int n = std::min(nframes, NFRAMES);
+  if(n == 0) return 0;
+
+  static double sorted[NFRAMES];
+  std::copy(frametime, frametime + n, sorted);
+  const int k = std::min(n-1, int(q*n));
+  std::nth_element(sorted, sorted + k, sorted + n);
+  return sorted[k];
+}
+
+// The number of frames finished in the last second
+static int frames_per_second()
+{
+  const double t = now_ms();
+  int n = 0;
+  for(int i = 0; i < std::min(nframes, NFRAMES); i++)
+    if(t - frameend[i] < 1e3) n++;
+  return n;
+}
+
+void perf_summary(char * buf, const int len)
+{
+  snprintf(buf, len,
+    "Draw %.1f ms (boxes %.1f, hits %.1f, save %.1f, tracks %.1f, "
+    "vertices %.1f, blit %.1f), median %.1f, 99%% %.1f ms, %d frames/s.  "
+    "%d hits drawn, %d culled.  Pick %.2f ms.  "
+    "Read %.1f ms, reco %.1f ms.",
+    lasttime[perfframe], lasttime[perfbackground], lasttime[perfhits],
+    lasttime[perfsave], lasttime[perftracks], lasttime[perfvertices],
+    lasttime[perfblit], frame_quantile(0.5), frame_quantile(0.99),
+    frames_per_second(), lastndrawn, lastnculled, lasttime[perfpick],
+    lasttime[perfingest], lasttime[perfreco]);
+}
@@ -0,0 +1,33 @@
+// Things that we time for the performance status line
+enum perfstage {
+  perfframe,      // all of draw_event()
+  perfbackground, // blanking and drawing the detector boxes
+  perfhits,       // draw_hits()
+  perfsave,       // saving the drawn hits in eventpattern
+  perftracks,     // draw_tracks()
+  perfvertices,   // draw_vertices()
+  perfblit,       // putting the finished drawing on the screen
+  perfpick,       // finding what the mouse is over
+  perfingest,     // converting an art event in noe::produce()
+  perfreco,       // converting reco positions, see convert_reco()
+  NPERFSTAGES
+};
+
+// Turn timing on or off.  It is off by default, in which case the functions
+// below return immediately.
+void perf_enable(const bool on);
+bool perf_enabled();
+
+// Mark the beginning and end of a stage.  Stages must nest, and a stage
+// should not be begun again before it has ended.  If we are writing a trace
+// file, each stage is also recorded there.
+void perf_begin(const perfstage s);
+void perf_end(const perfstage s);
+
+// Record how many hits the last draw_hits() drew, and how many were in the
+// time window but not drawn because they were off the screen.
+void perf_hits(const int ndrawn, const int nculled);
+
+// Write a one-line summary of the most recent timings, the median and 99th
+// percentile of recent frame times, and the recent frame rate, into 'buf'.
+void perf_summary(char * buf, const int len);
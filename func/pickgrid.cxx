@@ -0,0 +1,69 @@
+/* pickgrid.cxx: A spatial index of screen positions of tracks and vertices
+ * for fast mouseovers. */
+
+#include <vector>
+#include <algorithm>
+#include "pickgrid.h"
+
+void pickgrid_reset(pickgrid & g, const int width, const int height,
+                    const int radius)
+{
+  g.cellsize = std::max(1, radius);
+  g.xmin = g.ymin = -g.cellsize;
+  g.ncolumns = (width  + 2*g.cellsize)/g.cellsize + 1;
+  g.nrows    = (height + 2*g.cellsize)/g.cellsize + 1;
+
+  // Clear rather than reallocate so that redrawing the same event over and
+  // over doesn't churn memory.
+  g.cells.resize(g.ncolumns*g.nrows);
+  for(unsigned int i = 0; i < g.cells.size(); i++) g.cells[i].clear();
+}
+
+static int clamp(const int v, const int lo, const int hi)
+{
+  return v < lo? lo: v > hi? hi: v;
+}
+
+void pickgrid_add(pickgrid & g, const int i, const int xmin, const int ymin,
+                  const int xmax, const int ymax)
+{
+  // Entirely off the grid, so the pointer can never be near it
+  if(xmax < g.xmin || ymax < g.ymin ||
+     xmin >= g.xmin + g.ncolumns*g.cellsize ||
+     ymin >= g.ymin + g.nrows   *g.cellsize) return;
+
+  const int c0 = clamp((xmin - g.xmin)/g.cellsize, 0, g.ncolumns-1);
+  const int c1 = clamp((xmax - g.xmin)/g.cellsize, 0, g.ncolumns-1);
+  const int r0 = clamp((ymin - g.ymin)/g.cellsize, 0, g.nrows-1);
+  const int r1 = clamp((ymax - g.ymin)/g.cellsize, 0, g.nrows-1);
+
+  for(int r = r0; r <= r1; r++){
+    for(int c = c0; c <= c1; c++){
+      std::vector<int> & cell = g.cells[r*g.ncolumns + c];
+
+      // Objects are added in order, so this catches several parts of the
+      // same object (i.e. track segments) landing in the same grid cell.
+      if(cell.empty() || cell.back() != i) cell.push_back(i);
+    }
+  }
+}
+
+void pickgrid_candidates(const pickgrid & g, const int x, const int y,
+                         const int radius, std::vector<int> & out)
+{
+  out.clear();
+  if(g.cells.empty()) return;
+
+  const int c0 = clamp((x - radius - g.xmin)/g.cellsize, 0, g.ncolumns-1);
+  const int c1 = clamp((x + radius - g.xmin)/g.cellsize, 0, g.ncolumns-1);
+  const int r0 = clamp((y - radius - g.ymin)/g.cellsize, 0, g.nrows-1);
+  const int r1 = clamp((y + radius - g.ymin)/g.cellsize, 0, g.nrows-1);
+
+  for(int r = r0; r <= r1; r++)
+    for(int c = c0; c <= c1; c++)
+      out.insert(out.end(), g.cells[r*g.ncolumns + c].begin(),
+                            g.cells[r*g.ncolumns + c].end());
+
+  std::sort(out.begin(), out.end());
+  out.erase(std::unique(out.begin(), out.end()), out.end());
+}
@@ -0,0 +1,29 @@
+// A uniform grid over the screen for finding which reconstructed objects
+// are near the mouse pointer without checking all of them.  Each grid
+// cell holds the indices of the objects whose bounding boxes overlap it.
+struct pickgrid{
+  // Screen position of the upper left corner of the first grid cell
+  int xmin, ymin;
+
+  int cellsize; // in pixels
+  int ncolumns, nrows;
+
+  std::vector< std::vector<int> > cells;
+};
+
+// Empty the grid and set it up to cover a drawing area of the given size,
+// plus a margin of 'radius', the distance at which we will look for objects.
+void pickgrid_reset(pickgrid & g, const int width, const int height,
+                    const int radius);
+
+// Add object number 'i' with the given bounding box in screen coordinates.
+// Objects must be added in increasing order of 'i'.
+void pickgrid_add(pickgrid & g, const int i, const int xmin, const int ymin,
+                  const int xmax, const int ymax);
+
+// Fill 'out' with the indices of the objects whose bounding boxes come
+// within 'radius' of the screen position (x, y), in increasing order and
+// without duplicates.  All objects closer than 'radius' are returned, along
+// with some that are farther.
+void pickgrid_candidates(const pickgrid & g, const int x, const int y,
+                         const int radius, std::vector<int> & out);
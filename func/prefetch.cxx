@@ -0,0 +1,73 @@
+/* prefetch.cxx: Reading events ahead of the user in batches.  art only
+ * gives us an event when we return to it from the main loop, and while we
+ * are out, the GUI doesn't respond.  Reading one event per trip makes
+ * loading a file slow, since most of each trip is spent in the main loop
+ * waiting for the next timer.  Instead, read as many as fit in a time
+ * budget, using how long events have been taking to read to avoid going
+ * over it.
+ *
+ * While the user is doing something, or an animation is running, the
+ * budget is much smaller, and reading stops if an event takes longer than
+ * that. */
+
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include "prefetch.h"
+
+// Time budget while the user is idle, in ms
+static double idlebudget = 100;
+
+// Time budget while busy.  Less than a frame at 50Hz.
+static const double BUSYBUDGET = 10;
+
+// Most events to have read beyond the one being shown, or 0 for no limit
+static int maxahead = 0;
+
+// Estimated time to read one event, in ms, averaged over recent events.
+// Starts with a guess that lets an idle first trip read a few.
+static double eventcost = 20;
+
+// When the current trip out of the main loop and the current event started
+static double tripstart = 0, eventstart = 0;
+
+static double now_ms()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e3 + ts.tv_nsec*1e-6;
+}
+
+void prefetch_configure(const int budget_ms, const int readahead)
+{
+  idlebudget = std::max(1, budget_ms);
+  maxahead = std::max(0, readahead);
+}
+
+bool prefetch_should_start(const int ahead, const bool busy)
+{
+  if(maxahead > 0 && ahead >= maxahead) return false;
+
+  // Don't make the user wait for an event that probably takes longer to
+  // read than they would notice
+  return !busy || eventcost <= BUSYBUDGET;
+}
+
+void prefetch_begin()
+{
+  tripstart = eventstart = now_ms();
+}
+
+bool prefetch_continue(const int ahead, const bool busy)
+{
+  const double now = now_ms();
+
+  // Weight recent events more, since the size of events often changes
+  // through a file, e.g. from cosmic triggers to beam spills
+  eventcost = 0.75*eventcost + 0.25*(now - eventstart);
+  eventstart = now;
+
+  if(maxahead > 0 && ahead >= maxahead) return false;
+  if(busy) return false;
+  return now - tripstart + eventcost <= idlebudget;
+}
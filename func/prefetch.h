@@ -0,0 +1,19 @@
+// Deciding how many events to read from art each time we leave the main
+// loop to do it, when the user isn't waiting for any particular event.
+
+// Set the longest time, in milliseconds, to spend reading events before
+// going back to the main loop while the user is idle, and the most events
+// to have read beyond the one being shown, or zero for no limit.
+void prefetch_configure(const int budget_ms, const int readahead);
+
+// Whether to leave the main loop to read events now.  'ahead' is the number
+// of events already read beyond the one being shown, and 'busy' says that
+// the user is interacting or an animation is running.
+bool prefetch_should_start(const int ahead, const bool busy);
+
+// Call on leaving the main loop to read events
+void prefetch_begin();
+
+// Call after each event is read.  Returns true if another should be read
+// before going back to the main loop.
+bool prefetch_continue(const int ahead, const bool busy);
@@ -0,0 +1,304 @@
+/* prerender.cxx: Drawing the events next to the current one ahead of time,
+ * on a thread of its own so that it doesn't slow down whatever the user is
+ * doing, free running included.  Each one is drawn as draw_event() would
+ * draw it when switching to it: the background and hits of its whole
+ * selected time range.  Reco objects are cheap enough that they are still
+ * drawn on top at the time of switching.
+ *
+ * The thread reads nothing that the rest of the program changes.  It is
+ * handed a copy of the event's hits in range and of everything about the
+ * view that decides how they are drawn, and gives back image surfaces.  It
+ * doesn't touch the performance counters, so the status line only ever
+ * reports the drawing the user sees.
+ *
+ * A drawing is only used if nothing that affects how hits are drawn has
+ * changed since it was asked for.  Otherwise it is thrown away and asked
+ * for again. */
+
+#include <gtk/gtk.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+#include <deque>
+#include "event.h"
+#include "geo.h"
+#include "drawing.h"
+#include "hits.h"
+#include "merge.h"
+#include "prerender.h"
+
+extern std::vector<noeevent> theevents;
+extern int gevi;
+extern bool isfd;
+extern rect screenview[kXorY], screenmu;
+extern int first_mucatcher;
+extern int nplanes;
+
+// Everything that the drawing of an event's hits depends on
+struct viewkey{
+  hitstyle style;
+  int isfd;
+  int32_t mintick, maxtick;
+};
+
+// An event to be drawn, with everything needed to draw it
+struct prjob{
+  int evi;
+  viewkey key;
+  rect views[kXorY], mu;
+  bool hasmu;
+  std::vector<hit> hits; // in range and not hidden, in charge order
+};
+
+struct prerendered{
+  int evi; // index into theevents, or -1 if unused
+  viewkey key;
+  cairo_surface_t * surface[kXorY];
+};
+
+// The events kept are the current one, the one before it, so that stepping
+// back is quick, and the two after it, so that free running stays ahead.
+static const int NSLOTS = 4;
+static prerendered slots[NSLOTS] = {
+  { -1, viewkey(), { NULL } }, { -1, viewkey(), { NULL } },
+  { -1, viewkey(), { NULL } }, { -1, viewkey(), { NULL } } };
+
+// Guards everything below, which is shared with the drawing thread, and
+// the slots above
+static GMutex lock;
+static GCond jobready;
+static std::deque<prjob *> jobs;
+static int busyevi = -1; // being drawn right now
+static viewkey busykey;
+static int centre = 0;   // gevi as of the last prerender_schedule()
+
+static GThread * thread = NULL;
+
+static bool keep(const int evi)
+{
+  return evi >= centre-1 && evi <= centre+2;
+}
+
+static bool samekey(const viewkey & a, const viewkey & b)
+{
+  return !memcmp(&a, &b, sizeof a);
+}
+
+static viewkey current_key(const hitstyle & style, const noeevent & E)
+{
+  viewkey k;
+  memset(&k, 0, sizeof k);
+  k.style = style;
+  k.isfd = isfd;
+  k.mintick = E.user_mintick, k.maxtick = E.user_maxtick;
+  return k;
+}
+
+static void free_slot(prerendered & p)
+{
+  for(int V = 0; V < kXorY; V++){
+    if(p.surface[V] != NULL) cairo_surface_destroy(p.surface[V]);
+    p.surface[V] = NULL;
+  }
+  p.evi = -1;
+}
+
+// Draw the background and hits of a job into new surfaces.  Only one hit is
+// visible in each cell, the one with the most charge, so only that is drawn.
+static void render(const prjob & job, cairo_surface_t ** surface)
+{
+  const screenparams & sp = job.key.style.sp;
+  cairo_t * cr[kXorY];
+  for(int V = 0; V < kXorY; V++){
+    surface[V] = cairo_image_surface_create(CAIRO_FORMAT_RGB24,
+      job.key.style.width[V], job.key.style.height[V]);
+    cr[V] = cairo_create(surface[V]);
+  }
+
+  draw_boxes(cr, job.views, job.hasmu? &job.mu: NULL);
+
+  // Ties go to the later hit, as they do when drawing in order
+  std::vector<bool> seen;
+  std::vector<uint32_t> tops;
+  for(int i = (int)job.hits.size() - 1; i >= 0; i--){
+    const hit & h = job.hits[i];
+    const unsigned int c = h.plane*sp.ncells_perplane + h.cell;
+    if(c >= seen.size()) seen.resize(c+1);
+    if(seen[c]) continue;
+    seen[c] = true;
+    tops.push_back(i);
+  }
+
+  for(int i = (int)tops.size() - 1; i >= 0; i--){
+    const hit & h = job.hits[tops[i]];
+    draw_hit_styled(cr[h.plane%2 == 1?kX:kY], h, job.key.style, false);
+  }
+
+  for(int V = 0; V < kXorY; V++){
+    cairo_destroy(cr[V]);
+    cairo_surface_flush(surface[V]);
+  }
+}
+
+// Put a finished drawing in a slot, unless it is no longer wanted
+static void store(const prjob & job, cairo_surface_t ** surface)
+{
+  prerendered * p = NULL;
+  if(keep(job.evi)){
+    for(int i = 0; i < NSLOTS && p == NULL; i++)
+      if(slots[i].evi == job.evi) p = &slots[i];
+    for(int i = 0; i < NSLOTS && p == NULL; i++)
+      if(slots[i].evi < 0 || !keep(slots[i].evi)) p = &slots[i];
+  }
+
+  if(p == NULL){
+    for(int V = 0; V < kXorY; V++) cairo_surface_destroy(surface[V]);
+    return;
+  }
+
+  free_slot(*p);
+  p->evi = job.evi;
+  p->key = job.key;
+  for(int V = 0; V < kXorY; V++) p->surface[V] = surface[V];
+}
+
+static gpointer prerender_thread(__attribute__((unused)) gpointer data)
+{
+  g_mutex_lock(&lock);
+  while(true){
+    while(jobs.empty()) g_cond_wait(&jobready, &lock);
+    prjob * const job = jobs.front();
+    jobs.pop_front();
+    busyevi = job->evi;
+    busykey = job->key;
+    g_mutex_unlock(&lock);
+
+    cairo_surface_t * surface[kXorY];
+    render(*job, surface);
+
+    g_mutex_lock(&lock);
+    busyevi = -1;
+    store(*job, surface);
+    delete job;
+  }
+  return NULL;
+}
+
+// Whether theevents[evi] is drawn ahead of time, or being drawn, or waiting
+// to be, as it looks now.  Call with the lock held.
+static bool asked_for(const int evi, const viewkey & key)
+{
+  if(busyevi == evi && samekey(busykey, key)) return true;
+  for(unsigned int i = 0; i < jobs.size(); i++)
+    if(jobs[i]->evi == evi && samekey(jobs[i]->key, key)) return true;
+  for(int i = 0; i < NSLOTS; i++)
+    if(slots[i].evi == evi && samekey(slots[i].key, key)) return true;
+  return false;
+}
+
+// Copy out of theevents[evi] and the globals what drawing it needs
+static prjob * make_job(const int evi, const viewkey & key)
+{
+  noeevent & E = theevents[evi];
+  sort_hits_by_charge(E);
+
+  prjob * const job = new prjob;
+  job->evi = evi;
+  job->key = key;
+
+  setboxes();
+  for(int V = 0; V < kXorY; V++) job->views[V] = screenview[V];
+  job->mu = screenmu;
+  job->hasmu = first_mucatcher < nplanes;
+
+  const hitstyle & style = key.style;
+  const bool isolating = style.isolate_slice && style.active_slice > 0;
+  for(unsigned int i = 0; i < E.hits.size(); i++){
+    const hit & h = E.hits[i];
+    if(h.tdc < key.mintick || h.tdc > key.maxtick) continue;
+    if(isolating && h.slice != style.active_slice) continue;
+    job->hits.push_back(h);
+  }
+  return job;
+}
+
+void prerender_schedule()
+{
+  if(theevents.empty() || merge_count() != 1 || view_width(kX) <= 0) return;
+
+  if(thread == NULL)
+    thread = g_thread_new("prerender", prerender_thread, NULL);
+
+  const hitstyle style = current_hitstyle();
+
+  // Next first, since that's the way free running goes
+  const int neighbors[3] = { gevi+1, gevi+2, gevi-1 };
+  bool needed[3];
+
+  g_mutex_lock(&lock);
+  centre = gevi;
+
+  // Forget whatever is too far away or out of date
+  for(std::deque<prjob *>::iterator j = jobs.begin(); j != jobs.end();){
+    if(keep((*j)->evi) &&
+       samekey((*j)->key, current_key(style, theevents[(*j)->evi]))) j++;
+    else{
+      delete *j;
+      j = jobs.erase(j);
+    }
+  }
+  for(int i = 0; i < NSLOTS; i++)
+    if(slots[i].evi >= 0 && (!keep(slots[i].evi) ||
+       !samekey(slots[i].key, current_key(style, theevents[slots[i].evi]))))
+      free_slot(slots[i]);
+
+  for(int i = 0; i < 3; i++){
+    const int evi = neighbors[i];
+
+    // Switching to an FD event from ND ones changes the geometry first
+    needed[i] = evi >= 0 && evi < (int)theevents.size() &&
+                (isfd || !theevents[evi].fdlike) &&
+                !asked_for(evi, current_key(style, theevents[evi]));
+  }
+  g_mutex_unlock(&lock);
+
+  // Copying the hits takes a moment for a big event, so don't hold up the
+  // drawing thread meanwhile.  Only this thread adds jobs.
+  std::vector<prjob *> newjobs;
+  for(int i = 0; i < 3; i++)
+    if(needed[i])
+      newjobs.push_back(make_job(neighbors[i],
+                        current_key(style, theevents[neighbors[i]])));
+  if(newjobs.empty()) return;
+
+  g_mutex_lock(&lock);
+  jobs.insert(jobs.end(), newjobs.begin(), newjobs.end());
+  g_cond_signal(&jobready);
+  g_mutex_unlock(&lock);
+}
+
+bool prerender_paint(cairo_t ** cr, const DRAWPARS * const drawpars)
+{
+  if(!drawpars->clear || drawpars->bytns || merge_count() > 1) return false;
+
+  const noeevent & E = theevents[gevi];
+  if(drawpars->firsttick != E.user_mintick ||
+     drawpars->lasttick  != E.user_maxtick) return false;
+
+  const viewkey key = current_key(current_hitstyle(), E);
+
+  bool painted = false;
+  g_mutex_lock(&lock);
+  for(int i = 0; i < NSLOTS && !painted; i++){
+    if(slots[i].evi != gevi || !samekey(slots[i].key, key)) continue;
+    for(int V = 0; V < kXorY; V++){
+      cairo_set_source_surface(cr[V], slots[i].surface[V], 0, 0);
+      cairo_set_operator(cr[V], CAIRO_OPERATOR_SOURCE);
+      cairo_paint(cr[V]);
+      cairo_set_operator(cr[V], CAIRO_OPERATOR_OVER);
+    }
+    painted = true;
+  }
+  g_mutex_unlock(&lock);
+  return painted;
+}
@@ -0,0 +1,11 @@
+// Drawing the hits of the events before and after the current one on
+// another thread while the user is looking at it, so that going to them is
+// just a copy.
+
+// Hand the neighboring events to the drawing thread, if they haven't been
+// drawn already at the current zoom, pan and window size
+void prerender_schedule();
+
+// If the hits of the current event have already been drawn as asked for
+// by drawpars, put them in cr and return true.  Otherwise return false.
+bool prerender_paint(cairo_t ** cr, const DRAWPARS * const drawpars);
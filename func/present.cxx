@@ -0,0 +1,367 @@
+/* present.cxx: Ways of getting the views to the screen.  In all of them,
+ * each view is drawn into a surface that lasts as long as the window stays
+ * the same size (see offscreen[] in drawing.cxx) and then put on the screen.
+ *
+ * Direct mode: The surface is a pixmap in the X server, and each frame is
+ * one copy from it to the window.  An expose is served by the same copy
+ * instead of drawing the event again.
+ *
+ * Remote mode: Over a slow X connection, the many small drawing requests
+ * that Cairo makes for each hit, track and highlight are the bottleneck.
+ * After each frame, compare the image tile by tile to what we last sent.
+ * Only the changed tiles go to the X server, as image uploads.
+ *
+ * Shared memory mode: On a local display, draw into memory that the X server
+ * can read directly, so that putting a frame on the screen involves no
+ * copying through the X connection at all.
+ *
+ * Serve mode: There is no X server.  Just count frames so that serve.cxx
+ * knows when there is something new to send.
+ *
+ * In the first three, when the caller says which areas changed (see
+ * compose.cxx), only those are copied, sent or compared. */
+
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include "event.h"
+#include "geo.h"
+#include "present.h"
+#include "trace.h"
+
+extern GtkWidget * edarea[kXorY];
+extern cairo_surface_t * offscreen[kXorY];
+
+static presentmode mode = presentdirect;
+
+// Bits to keep of each pixel.  Dropping the low bits of each channel makes
+// the images much more compressible, e.g. by "ssh -C".
+static uint32_t colormask = 0xffffffff;
+
+// Copy of what we last sent to the X server for each view in remote mode.
+// Empty if we don't know.
+static std::vector<uint32_t> onscreen[kXorY];
+
+// True if offscreen[] holds a whole frame at its current size
+static bool complete[kXorY] = { false };
+
+// The size offscreen[] was made.  In direct mode it isn't an image surface,
+// so Cairo can't tell us.
+static int offw[kXorY] = { 0 }, offh[kXorY] = { 0 };
+
+// In shared memory mode, the images that offscreen[] draws into
+static GdkImage * shmimage[kXorY] = { NULL };
+static GdkGC * shmgc[kXorY] = { NULL };
+
+static unsigned int npresented = 0;
+
+// The areas of each view to put on the screen next time, if 'partial' is
+// set.  Otherwise, all of both views.
+static std::vector<rect> pending[kXorY];
+static bool partial = false;
+
+// Side length of the squares that are compared and sent, in pixels.  Small
+// enough that a highlighted cell doesn't cause much to be sent, big enough
+// that a whole changed frame doesn't turn into a huge number of requests.
+static const int TILE = 32;
+
+void present_enable(const presentmode m, const int colorbits)
+{
+  mode = m;
+  const int bits = std::max(1, std::min(8, colorbits));
+  const uint32_t c = (0xff << (8 - bits)) & 0xff;
+  colormask = 0xff000000 | (c << 16) | (c << 8) | c;
+}
+
+bool presenting()
+{
+  return mode != presentdirect;
+}
+
+unsigned int present_count()
+{
+  return npresented;
+}
+
+void present_set_size(const int w, const int h)
+{
+  if(mode != presentserve) return;
+  for(int V = 0; V < kXorY; V++){
+    if(offscreen[V] != NULL) cairo_surface_destroy(offscreen[V]);
+    offscreen[V] = cairo_image_surface_create(CAIRO_FORMAT_RGB24, w, h);
+  }
+}
+
+static void free_view(const int V)
+{
+  if(offscreen[V] != NULL) cairo_surface_destroy(offscreen[V]);
+  offscreen[V] = NULL;
+  if(shmimage[V] != NULL) g_object_unref(shmimage[V]);
+  shmimage[V] = NULL;
+  onscreen[V].clear();
+  complete[V] = false;
+}
+
+// Make a shared memory image for view V and a Cairo surface that draws
+// into it.  Returns false if that can't be done, e.g. because the display
+// isn't local, or the visual isn't laid out the way Cairo draws.
+static bool make_shm_view(const int V, const int w, const int h)
+{
+  GdkVisual * const visual = gtk_widget_get_visual(edarea[V]);
+  const uint32_t one = 1;
+  const bool hostlsb = *(const uint8_t *)&one == 1;
+  if(visual->type != GDK_VISUAL_TRUE_COLOR || visual->depth != 24 ||
+     visual->red_mask != 0xff0000 || visual->green_mask != 0xff00 ||
+     visual->blue_mask != 0xff ||
+     visual->byte_order != (hostlsb? GDK_LSB_FIRST: GDK_MSB_FIRST))
+    return false;
+
+  // GDK checks for the MIT-SHM extension and that attaching works
+  if((shmimage[V] = gdk_image_new(GDK_IMAGE_SHARED, visual, w, h)) == NULL)
+    return false;
+
+  if(shmimage[V]->bpp != 4 ||
+     shmimage[V]->bpl != cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, w))
+    return false;
+
+  offscreen[V] = cairo_image_surface_create_for_data(
+    (unsigned char *)shmimage[V]->mem, CAIRO_FORMAT_RGB24, w, h,
+    shmimage[V]->bpl);
+
+  if(shmgc[V] == NULL) shmgc[V] = gdk_gc_new(edarea[V]->window);
+  return true;
+}
+
+// Make a pixmap in the X server like view V's window to draw into
+static void make_direct_view(const int V, const int w, const int h)
+{
+  cairo_t * cr = gdk_cairo_create(edarea[V]->window);
+  offscreen[V] = cairo_surface_create_similar(cairo_get_target(cr),
+                                              CAIRO_CONTENT_COLOR, w, h);
+  cairo_destroy(cr);
+}
+
+void present_damage(const int V, const int x, const int y, const int w,
+                    const int h)
+{
+  rect r;
+  r.xmin = x, r.ymin = y, r.xsize = w, r.ysize = h;
+  pending[V].push_back(r);
+  partial = true;
+}
+
+// Add the areas of view V to be put on the screen to the current path
+static void pending_path(cairo_t * cr, const int V)
+{
+  if(!partial){
+    cairo_rectangle(cr, 0, 0, offw[V], offh[V]);
+    return;
+  }
+  for(unsigned int i = 0; i < pending[V].size(); i++)
+    cairo_rectangle(cr, pending[V][i].xmin, pending[V][i].ymin,
+                        pending[V][i].xsize, pending[V][i].ysize);
+}
+
+void present_prepare()
+{
+  if(mode == presentserve) return;
+  for(int V = 0; V < kXorY; V++){
+    // Without a window, e.g. in a benchmark, the caller set offscreen[]
+    if(edarea[V] == NULL || edarea[V]->window == NULL) continue;
+
+    const int w = std::max(1, edarea[V]->allocation.width);
+    const int h = std::max(1, edarea[V]->allocation.height);
+    if(offscreen[V] != NULL && offw[V] == w && offh[V] == h) continue;
+
+    free_view(V);
+    offw[V] = w, offh[V] = h;
+
+    if(mode == presentdirect){
+      make_direct_view(V, w, h);
+    }
+    else if(mode == presentremote){
+      offscreen[V] = cairo_image_surface_create(CAIRO_FORMAT_RGB24, w, h);
+    }
+    else if(!make_shm_view(V, w, h)){
+      fprintf(stderr, "NOE: Can't use shared memory with this display. "
+              "Drawing normally.\n");
+      for(int i = 0; i < kXorY; i++) free_view(i);
+      mode = presentdirect;
+      present_prepare();
+      return;
+    }
+  }
+}
+
+// Put the changed areas of both views on the screen from shared memory.
+// Wait until the X server has done it, since otherwise the next frame could
+// be drawn into the memory while it is still being read.
+static void present_shm_views()
+{
+  for(int V = 0; V < kXorY; V++){
+    if(shmimage[V] == NULL) continue;
+    cairo_surface_flush(offscreen[V]);
+    if(!partial)
+      gdk_draw_image(edarea[V]->window, shmgc[V], shmimage[V], 0, 0, 0, 0,
+                     shmimage[V]->width, shmimage[V]->height);
+    for(unsigned int i = 0; partial && i < pending[V].size(); i++){
+      const rect & r = pending[V][i];
+      gdk_draw_image(edarea[V]->window, shmgc[V], shmimage[V],
+                     r.xmin, r.ymin, r.xmin, r.ymin, r.xsize, r.ysize);
+    }
+    complete[V] = true;
+  }
+  gdk_flush();
+}
+
+// Copy the changed areas of both views from their pixmaps to the windows.
+// This happens within the X server.
+static void present_direct_views()
+{
+  for(int V = 0; V < kXorY; V++){
+    if(offscreen[V] == NULL || edarea[V] == NULL) continue;
+    cairo_t * cr = gdk_cairo_create(edarea[V]->window);
+    cairo_set_source_surface(cr, offscreen[V], 0, 0);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    pending_path(cr, V);
+    cairo_fill(cr);
+    cairo_destroy(cr);
+    complete[V] = true;
+  }
+}
+
+// Whether the given area of view V might have changed
+static bool maybe_changed(const int V, const rect & r)
+{
+  if(!partial) return true;
+  for(unsigned int i = 0; i < pending[V].size(); i++)
+    if(pending[V][i].overlaps(r)) return true;
+  return false;
+}
+
+// Reduce the color depth of the tile at (x, y) of size w by h, compare it
+// to the copy of what is on the screen, and update that copy.  Returns true
+// if it changed.
+static bool tile_changed(uint32_t * const pix, const int stride,
+                         uint32_t * const sent, const int width,
+                         const int x, const int y, const int w, const int h)
+{
+  bool changed = false;
+  for(int row = y; row < y + h; row++){
+    uint32_t * const p = pix + row*stride + x;
+    uint32_t * const s = sent + row*width + x;
+    if(colormask != 0xffffffff)
+      for(int i = 0; i < w; i++) p[i] &= colormask;
+    if(memcmp(p, s, w*sizeof(uint32_t))){
+      memcpy(s, p, w*sizeof(uint32_t));
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+// Done putting things on the screen, so start over with the whole views
+static void present_done()
+{
+  for(int V = 0; V < kXorY; V++) pending[V].clear();
+  partial = false;
+}
+
+void present_views()
+{
+  npresented++;
+  if(mode == presentserve){
+    present_done();
+    return;
+  }
+
+  trace_begin("present_views");
+  if(mode == presentdirect){
+    present_direct_views();
+    present_done();
+    trace_end("present_views");
+    return;
+  }
+  if(mode == presentshm){
+    present_shm_views();
+    present_done();
+    trace_end("present_views");
+    return;
+  }
+
+  for(int V = 0; V < kXorY; V++){
+    if(offscreen[V] == NULL) continue;
+
+    cairo_surface_flush(offscreen[V]);
+    uint32_t * const pix = (uint32_t *)cairo_image_surface_get_data(offscreen[V]);
+    const int stride = cairo_image_surface_get_stride(offscreen[V])/4;
+    const int w = cairo_image_surface_get_width (offscreen[V]);
+    const int h = cairo_image_surface_get_height(offscreen[V]);
+
+    // If we don't know what is on the screen, start from something that
+    // can't match, so that everything is sent.  Otherwise, only tiles in
+    // areas that might have changed need to be looked at.
+    const bool known = (int)onscreen[V].size() == w*h;
+    if(!known) onscreen[V].assign(w*h, 0xffffffff);
+
+    // Find each horizontal run of changed tiles.  This also reduces the
+    // color depth, so must be done before handing the surface to Cairo.
+    std::vector<rect> runs;
+    for(int y = 0; y < h; y += TILE){
+      const int th = std::min(TILE, h - y);
+      rect run;
+      run.xsize = 0;
+      for(int x = 0; x < w; x += TILE){
+        const int tw = std::min(TILE, w - x);
+        rect tile;
+        tile.xmin = x, tile.ymin = y, tile.xsize = tw, tile.ysize = th;
+        if((!known || maybe_changed(V, tile)) &&
+           tile_changed(pix, stride, &onscreen[V][0], w, x, y, tw, th)){
+          if(run.xsize == 0) run.xmin = x, run.ymin = y, run.ysize = th;
+          run.xsize = x + tw - run.xmin;
+        }
+        else if(run.xsize != 0){
+          runs.push_back(run);
+          run.xsize = 0;
+        }
+      }
+      if(run.xsize != 0) runs.push_back(run);
+    }
+
+    complete[V] = true;
+    if(runs.empty()) continue;
+    if(colormask != 0xffffffff) cairo_surface_mark_dirty(offscreen[V]);
+
+    // Send each run as a separate request so that Cairo uploads only the
+    // changed pixels, not the bounding box of all of them.
+    cairo_t * cr = gdk_cairo_create(edarea[V]->window);
+    cairo_set_source_surface(cr, offscreen[V], 0, 0);
+    cairo_set_operator(cr, CAIRO_OPERATOR_SOURCE);
+    for(unsigned int i = 0; i < runs.size(); i++){
+      cairo_rectangle(cr, runs[i].xmin, runs[i].ymin,
+                          runs[i].xsize, runs[i].ysize);
+      cairo_fill(cr);
+    }
+    cairo_destroy(cr);
+  }
+  present_done();
+  trace_end("present_views");
+}
+
+bool present_repaint()
+{
+  if(mode == presentserve) return false;
+  for(int V = 0; V < kXorY; V++)
+    if(edarea[V] == NULL || offscreen[V] == NULL || !complete[V] ||
+       offw[V] != edarea[V]->allocation.width ||
+       offh[V] != edarea[V]->allocation.height)
+      return false;
+
+  for(int V = 0; V < kXorY; V++) onscreen[V].clear();
+  present_done();
+  present_views();
+  return true;
+}
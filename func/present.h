@@ -0,0 +1,50 @@
+enum presentmode {
+  // Cairo draws straight to the windows.  The default.
+  presentdirect,
+
+  // Views are drawn into client-side image surfaces and only the parts that
+  // changed since the last frame are sent to the X server.  For slow remote
+  // connections.
+  presentremote,
+
+  // Views are drawn into shared memory images and each frame is put on the
+  // screen with one MIT-SHM request per view.  For local displays.  Falls
+  // back to presentdirect if shared memory isn't available.
+  presentshm,
+
+  // There are no windows.  Views are drawn into image surfaces the size
+  // given to present_set_size(), which are sent to a browser (see serve.cxx).
+  presentserve
+};
+
+// Choose how views get to the screen.  'colorbits' is the number of bits
+// kept per color channel in presentremote mode, 1-8.
+void present_enable(const presentmode mode, const int colorbits);
+bool presenting();
+
+// In presentserve mode, set the size of the views.  Does nothing otherwise,
+// since the windows have a size.
+void present_set_size(const int w, const int h);
+
+// The number of times the views have been presented, so that a browser can
+// tell whether it needs to fetch them again
+unsigned int present_count();
+
+// Make the offscreen surfaces match the size of the windows.  To be called
+// before drawing a whole frame.
+void present_prepare();
+
+// Say that the next present_views() only needs to put the given area of
+// view V on the screen, plus any others given.  Without any, it puts all of
+// both views there.
+void present_damage(const int V, const int x, const int y, const int w,
+                    const int h);
+
+// Send the parts of the views that changed since last time to the screen.
+// To be called after drawing.
+void present_views();
+
+// If we have a complete drawing of the views at the current window size,
+// put all of it on the screen and return true.  For use on expose, when
+// we don't know what the X server still has.
+bool present_repaint();
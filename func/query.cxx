@@ -0,0 +1,325 @@
+/* query.cxx: Finding events that match an expression over their summaries
+ * (see eventsummary in event.h), so that the user doesn't have to look at
+ * every event to find interesting ones.
+ *
+ * The query is compiled once into a list of operations in postfix order,
+ * which is then run on each event's summary, never looking at the hits.
+ * Long lists of events are split between several threads. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include "event.h"
+#include "query.h"
+
+extern std::vector<noeevent> theevents;
+
+// The names that can be used in queries, in the order of queryvar
+static const char * const varnames[] = {
+  "nhits", "nhitsx", "nhitsy", "adcsum", "adcmax", "tickspan",
+  "ntracks", "nvertices", "nslices", "fdlike", "run", "subrun", "event" };
+
+enum queryvar { vnhits, vnhitsx, vnhitsy, vadcsum, vadcmax, vtickspan,
+  vntracks, vnvertices, vnslices, vfdlike, vrun, vsubrun, vevent, NQUERYVARS };
+
+enum queryop { qnum, qvar, qneg, qnot, qadd, qsub, qmul, qdiv,
+               qlt, qle, qgt, qge, qeq, qne, qand, qor };
+
+struct queryitem{
+  queryop op;
+  double num; // for qnum
+  queryvar var; // for qvar
+};
+
+// The most values on the stack while evaluating a query
+static const int MAXDEPTH = 64;
+
+// Don't bother starting a thread for fewer events than this
+static const int MINPERTHREAD = 8192;
+
+// The compiled query
+static std::vector<queryitem> program;
+
+/*********************************************************************/
+/*                             Parsing                               */
+/*********************************************************************/
+
+// State of the parse in progress.  There is only ever one.
+static const char * text = NULL;
+static int pos = 0;
+static std::vector<queryitem> parsed;
+static int depth = 0, maxdepth = 0;
+static char * parseerr = NULL;
+static int parseerrlen = 0;
+
+static bool parse_or();
+
+static bool fail(const char * const what)
+{
+  snprintf(parseerr, parseerrlen, "%s at position %d of query", what, pos+1);
+  return false;
+}
+
+static void skip_space()
+{
+  while(isspace(text[pos])) pos++;
+}
+
+// If the next thing in the text is 'tok', skip over it and return true
+static bool accept(const char * const tok)
+{
+  skip_space();
+  const int n = strlen(tok);
+  if(strncmp(text+pos, tok, n)) return false;
+  pos += n;
+  return true;
+}
+
+// Add an operation, keeping track of how deep the stack gets.  Numbers and
+// variables push a value, unary operators don't change the depth, and
+// binary operators replace two values with one.
+static void emit(const queryop op, const double num = 0,
+                 const queryvar var = vnhits)
+{
+  queryitem item;
+  item.op = op, item.num = num, item.var = var;
+  parsed.push_back(item);
+
+  if(op == qnum || op == qvar) depth++;
+  else if(op != qneg && op != qnot) depth--;
+  maxdepth = std::max(maxdepth, depth);
+}
+
+static bool parse_primary()
+{
+  skip_space();
+  if(accept("(")){
+    if(!parse_or()) return false;
+    if(!accept(")")) return fail("Expected )");
+    return true;
+  }
+
+  if(isdigit(text[pos]) || text[pos] == '.'){
+    char * end;
+    const double num = strtod(text+pos, &end);
+    pos = end - text;
+    emit(qnum, num);
+    return true;
+  }
+
+  if(isalpha(text[pos])){
+    int n = 0;
+    while(isalnum(text[pos+n]) || text[pos+n] == '_') n++;
+    for(int v = 0; v < NQUERYVARS; v++){
+      if((int)strlen(varnames[v]) == n && !strncmp(text+pos, varnames[v], n)){
+        pos += n;
+        emit(qvar, 0, (queryvar)v);
+        return true;
+      }
+    }
+    return fail("Unknown name");
+  }
+
+  return fail(text[pos] == '\0'? "Unexpected end": "Unexpected character");
+}
+
+static bool parse_unary()
+{
+  if(accept("-")){
+    if(!parse_unary()) return false;
+    emit(qneg);
+    return true;
+  }
+  skip_space();
+  if(text[pos] == '!' && text[pos+1] != '='){
+    pos++;
+    if(!parse_unary()) return false;
+    emit(qnot);
+    return true;
+  }
+  return parse_primary();
+}
+
+static bool parse_product()
+{
+  if(!parse_unary()) return false;
+  while(true){
+    queryop op;
+    if     (accept("*")) op = qmul;
+    else if(accept("/")) op = qdiv;
+    else return true;
+    if(!parse_unary()) return false;
+    emit(op);
+  }
+}
+
+static bool parse_sum()
+{
+  if(!parse_product()) return false;
+  while(true){
+    queryop op;
+    if     (accept("+")) op = qadd;
+    else if(accept("-")) op = qsub;
+    else return true;
+    if(!parse_product()) return false;
+    emit(op);
+  }
+}
+
+static bool parse_comparison()
+{
+  if(!parse_sum()) return false;
+  queryop op;
+  // Longer operators first so that "<=" isn't taken as "<"
+  if     (accept("<=")) op = qle;
+  else if(accept(">=")) op = qge;
+  else if(accept("==")) op = qeq;
+  else if(accept("!=")) op = qne;
+  else if(accept("<"))  op = qlt;
+  else if(accept(">"))  op = qgt;
+  else if(accept("="))  op = qeq;
+  else return true;
+  if(!parse_sum()) return false;
+  emit(op);
+  return true;
+}
+
+static bool parse_and()
+{
+  if(!parse_comparison()) return false;
+  while(accept("&&")){
+    if(!parse_comparison()) return false;
+    emit(qand);
+  }
+  return true;
+}
+
+static bool parse_or()
+{
+  if(!parse_and()) return false;
+  while(accept("||")){
+    if(!parse_and()) return false;
+    emit(qor);
+  }
+  return true;
+}
+
+bool query_set(const char * const querytext, char * const err,
+               const int errlen)
+{
+  text = querytext, pos = 0;
+  parseerr = err, parseerrlen = errlen;
+  parsed.clear();
+  depth = maxdepth = 0;
+
+  if(!parse_or()) return false;
+  skip_space();
+  if(text[pos] != '\0') return fail("Unexpected text");
+  if(maxdepth > MAXDEPTH) return fail("Too complicated");
+
+  program.swap(parsed);
+  return true;
+}
+
+/*********************************************************************/
+/*                            Evaluation                             */
+/*********************************************************************/
+
+static double value(const noeevent & E, const queryvar v)
+{
+  const eventsummary & s = E.summary;
+  switch(v){
+    case vnhits:     return s.nhits;
+    case vnhitsx:    return s.nhitsx;
+    case vnhitsy:    return s.nhitsy;
+    case vadcsum:    return s.adcsum;
+    case vadcmax:    return s.adcmax;
+    case vtickspan:  return s.tickspan;
+    case vntracks:   return s.ntracks;
+    case vnvertices: return s.nvertices;
+    case vnslices:   return s.nslices;
+    case vfdlike:    return s.fdlike;
+    case vrun:       return E.nrun;
+    case vsubrun:    return E.nsubrun;
+    case vevent:     return E.nevent;
+    default:         return 0;
+  }
+}
+
+static bool matches(const noeevent & E)
+{
+  double stack[MAXDEPTH];
+  int n = 0;
+  for(unsigned int i = 0; i < program.size(); i++){
+    const queryitem & it = program[i];
+    switch(it.op){
+      case qnum: stack[n++] = it.num; continue;
+      case qvar: stack[n++] = value(E, it.var); continue;
+      case qneg: stack[n-1] = -stack[n-1]; continue;
+      case qnot: stack[n-1] = stack[n-1] == 0; continue;
+      default: break;
+    }
+
+    const double b = stack[--n];
+    double & a = stack[n-1];
+    switch(it.op){
+      case qadd: a = a + b; break;
+      case qsub: a = a - b; break;
+      case qmul: a = a * b; break;
+      case qdiv: a = b == 0? 0: a / b; break;
+      case qlt:  a = a <  b; break;
+      case qle:  a = a <= b; break;
+      case qgt:  a = a >  b; break;
+      case qge:  a = a >= b; break;
+      case qeq:  a = a == b; break;
+      case qne:  a = a != b; break;
+      case qand: a = a != 0 && b != 0; break;
+      case qor:  a = a != 0 || b != 0; break;
+      default: break;
+    }
+  }
+  return n == 1 && stack[0] != 0;
+}
+
+// Put the index of the first event in [begin, end) that matches in
+// 'result', or -1 if none do
+static void find_in(const int begin, const int end, int * const result)
+{
+  *result = -1;
+  for(int i = begin; i < end; i++){
+    if(matches(theevents[i])){
+      *result = i;
+      return;
+    }
+  }
+}
+
+int query_next(const int from)
+{
+  const int begin = from + 1, end = theevents.size();
+  if(program.empty() || begin >= end) return -1;
+
+  const int nthreads = std::max(1, std::min((end - begin)/MINPERTHREAD,
+                                (int)std::thread::hardware_concurrency()));
+
+  // Each thread looks at one part of the events.  The answer is the match
+  // from the earliest part that has one.
+  const int chunk = (end - begin + nthreads - 1)/nthreads;
+  std::vector<int> results(nthreads);
+  std::vector<std::thread> threads;
+  for(int t = 1; t < nthreads; t++)
+    threads.push_back(std::thread(find_in, begin + t*chunk,
+      std::min(end, begin + (t+1)*chunk), &results[t]));
+  find_in(begin, std::min(end, begin + chunk), &results[0]);
+
+  for(unsigned int t = 0; t < threads.size(); t++) threads[t].join();
+
+  for(int t = 0; t < nthreads; t++)
+    if(results[t] >= 0) return results[t];
+  return -1;
+}
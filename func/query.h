@@ -0,0 +1,14 @@
+// Finding events by their summaries.  A query is an expression like
+//
+//   nhits > 5000 && ntracks >= 2
+//
+// made of numbers, the names in query.cxx, comparisons, arithmetic, !, &&,
+// || and parentheses.  An event matches if the expression isn't zero.
+
+// Make 'text' the query used by query_next().  Returns false, and puts a
+// message in 'err', if it isn't a valid query.
+bool query_set(const char * const text, char * const err, const int errlen);
+
+// The index in theevents of the first event after 'from' that matches the
+// query, or -1 if none of the events read so far do.
+int query_next(const int from);
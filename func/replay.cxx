@@ -0,0 +1,129 @@
+/* replay.cxx: Recording of user input to a file and replaying it, so that
+ * interactive slowness can be reproduced and measured.
+ *
+ * The file has one line per input: the time in milliseconds since recording
+ * started, a letter for the kind of input (see inputkind) and four integers
+ * whose meaning depends on the kind. */
+
+#include <stdio.h>
+#include <time.h>
+#include <vector>
+#include <algorithm>
+#include "replay.h"
+
+static FILE * recordfile = NULL;
+static double clockstart = 0;
+
+// When record_input() was last called, whether or not we are recording
+static double lastinput = 0;
+
+static std::vector<inputrecord> toreplay;
+static unsigned int nextreplay = 0;
+
+// Response times of replayed inputs, indexed by kind
+static std::vector<double> latencies[128];
+
+static double now_ms()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e3 + ts.tv_nsec*1e-6;
+}
+
+void record_open(const char * const filename)
+{
+  if((recordfile = fopen(filename, "w")) == NULL){
+    fprintf(stderr, "NOE: could not open \"%s\" to record input\n", filename);
+    return;
+  }
+}
+
+void input_clock_start()
+{
+  clockstart = now_ms();
+}
+
+double input_clock()
+{
+  return now_ms() - clockstart;
+}
+
+double input_idle()
+{
+  return now_ms() - lastinput;
+}
+
+void record_input(const inputkind kind, const int a, const int b,
+                  const int c, const int d)
+{
+  lastinput = now_ms();
+  if(recordfile == NULL) return;
+  fprintf(recordfile, "%.1f %c %d %d %d %d\n",
+          input_clock(), (char)kind, a, b, c, d);
+
+  // So that the recording is complete even if we are killed
+  fflush(recordfile);
+}
+
+bool replay_load(const char * const filename)
+{
+  FILE * const f = fopen(filename, "r");
+  if(f == NULL){
+    fprintf(stderr, "NOE: could not open \"%s\" to replay input\n", filename);
+    return false;
+  }
+
+  inputrecord r;
+  while(6 == fscanf(f, "%lf %c %d %d %d %d",
+                    &r.t, &r.kind, &r.a, &r.b, &r.c, &r.d))
+    toreplay.push_back(r);
+
+  fclose(f);
+  nextreplay = 0;
+  return true;
+}
+
+bool replaying()
+{
+  return nextreplay < toreplay.size();
+}
+
+bool replay_next(inputrecord & r)
+{
+  if(!replaying()) return false;
+  r = toreplay[nextreplay++];
+  return true;
+}
+
+void replay_latency(const char kind, const double ms)
+{
+  latencies[kind & 0x7f].push_back(ms);
+}
+
+static double quantile(std::vector<double> & v, const double q)
+{
+  const unsigned int k = std::min(v.size()-1, (size_t)(q*v.size()));
+  std::nth_element(v.begin(), v.begin() + k, v.end());
+  return v[k];
+}
+
+void replay_report()
+{
+  const char kinds[] = { inmotion, inpress, inscroll, inslider, incheckbox,
+                         inclick, ingoto };
+  const char * const names[] = { "motion", "button press", "scroll", "slider",
+                                 "check box", "button click", "go to event" };
+
+  printf("NOE replay: response times in ms\n");
+  for(unsigned int i = 0; i < sizeof kinds; i++){
+    std::vector<double> & v = latencies[(int)kinds[i]];
+    if(v.empty()) continue;
+    printf("%-13s n = %6d  median %8.2f  90%% %8.2f  99%% %8.2f  "
+           "max %8.2f\n", names[i], (int)v.size(), quantile(v, 0.5),
+           quantile(v, 0.9), quantile(v, 0.99),
+           *std::max_element(v.begin(), v.end()));
+  }
+
+  // We are about to _exit(), which doesn't flush
+  fflush(stdout);
+}
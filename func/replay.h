@@ -0,0 +1,57 @@
+// Kinds of user input that can be recorded and replayed.  The values are
+// what appear in the log file.
+enum inputkind {
+  inmotion   = 'm', // a = view, b = x, c = y, d = modifier/button state
+  inpress    = 'p', // a = view, b = x, c = y
+  inscroll   = 's', // a = view, b = x, c = y, d = direction
+  inslider   = 'v', // a = which inputslider, b = new value
+  incheckbox = 'c', // a = which inputcheckbox, b = new state
+  inclick    = 'k', // a = which inputbutton
+  ingoto     = 'g'  // a = event number typed by the user
+};
+
+enum inputslider   { slidermintick, slidermaxtick, sliderspeed, slidermerge,
+                     sliderslice };
+enum inputcheckbox { checkanimate, checkcumulative, checkfreerun,
+                     checkisolate, checktns, checkslicecolor,
+                     checklayer /* plus the layer number */ };
+enum inputbutton   { buttonprev, buttonnext, buttonrestart };
+
+struct inputrecord {
+  double t; // milliseconds since input_clock_start()
+  char kind;
+  int a, b, c, d;
+};
+
+// Start recording user input to the named file
+void record_open(const char * const filename);
+
+// Set the time zero for both recording and replaying, which should be when
+// the window first appears.
+void input_clock_start();
+
+// Milliseconds since input_clock_start()
+double input_clock();
+
+// Milliseconds since the user last gave any input that record_input() was
+// called for, whether or not we are recording
+double input_idle();
+
+// Record one input, if we are recording.  Unused arguments should be zero.
+void record_input(const inputkind kind, const int a, const int b = 0,
+                  const int c = 0, const int d = 0);
+
+// Read a recording to be replayed.  Returns false if it can't be read.
+bool replay_load(const char * const filename);
+
+// True if a recording has been loaded and not fully replayed yet
+bool replaying();
+
+// Get the next input to replay.  Returns false if there are no more.
+bool replay_next(inputrecord & r);
+
+// Record how long the program took to respond to a replayed input
+void replay_latency(const char kind, const double ms);
+
+// Print the distribution of response times for each kind of input
+void replay_report();
@@ -0,0 +1,328 @@
+/* serve.cxx: A small HTTP server so that events can be looked at in a web
+ * browser, for when X forwarding is painful.  The views are drawn on this
+ * side into image surfaces by the usual drawing code (see presentserve in
+ * present.cxx) and sent as PNGs.  It only listens on localhost, so use it
+ * through an ssh tunnel, e.g. "ssh -L 8080:localhost:8080".
+ *
+ * GET /              A page that shows the views and sends commands
+ * GET /view/N.png    The X (N = 0) or Y (N = 1) view as a PNG
+ * GET /state         JSON with the frame count and the status lines.  The
+ *                    page polls this and only fetches the views again if
+ *                    the frame count changed.
+ * GET /cmd?c=C&v=V&x=X&y=Y  Run command C, see serve_command() in main.cxx
+ *
+ * Each connection is read and written on a thread of its own, so a slow
+ * client can't hold up the display.  Only making the response, which looks
+ * at the event and the views, is done on the main thread, in between its
+ * other work. */
+
+#include <gtk/gtk.h>
+#include <gio/gio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "event.h"
+#include "geo.h"
+#include "status.h"
+#include "present.h"
+#include "serve.h"
+#include "trace.h"
+
+extern cairo_surface_t * offscreen[kXorY];
+
+static int port = 0;
+
+static const char * const page =
+"<!DOCTYPE html>\n"
+"<html><head><title>NOE</title><style>\n"
+"body { background: #222; color: #ddd; font-family: sans-serif; }\n"
+"img { display: block; cursor: crosshair; }\n"
+"pre { margin: 2px; }\n"
+"</style></head><body>\n"
+"<div>\n"
+"<button onclick=\"cmd('prev')\">Previous</button>\n"
+"<button onclick=\"cmd('next')\">Next</button>\n"
+"Ticks <input id=mint size=6> to <input id=maxt size=6>\n"
+"<button onclick=\"cmd('ticks',0,+mint.value,+maxt.value)\">Set</button>\n"
+"<label><input type=checkbox onchange=\"cmd('animate',+this.checked)\">"
+"Animate</label>\n"
+"<label><input type=checkbox checked "
+"onchange=\"cmd('cumulative',+this.checked)\">Cumulative</label>\n"
+"<label><input type=checkbox onchange=\"cmd('tns',+this.checked)\">"
+"By TNS</label>\n"
+"<button onclick=\"cmd('restart')\">Restart animation</button>\n"
+"<label><input type=checkbox onchange=\"cmd('freerun',+this.checked)\">"
+"Free running</label>\n"
+"Speed <input type=number min=1 max=11 value=6 "
+"onchange=\"cmd('speed',+this.value)\">\n"
+"Merge <input type=number min=1 value=1 "
+"onchange=\"cmd('merge',+this.value)\">\n"
+"Slice <input type=number min=0 value=0 "
+"onchange=\"cmd('slice',+this.value)\">\n"
+"<label><input type=checkbox onchange=\"cmd('isolate',+this.checked)\">"
+"Only this slice</label>\n"
+"<label><input type=checkbox onchange=\"cmd('slicecolor',+this.checked)\">"
+"Color slices</label>\n"
+"Layer <input id=lay type=number min=0 value=0>\n"
+"<button onclick=\"cmd('layer',1,+lay.value)\">Show</button>\n"
+"<button onclick=\"cmd('layer',0,+lay.value)\">Hide</button>\n"
+"Event <input id=ev size=8>\n"
+"<button onclick=\"cmd('goto',+ev.value)\">Go</button>\n"
+"</div>\n"
+"<pre id=status></pre>\n"
+"<img id=v0><img id=v1>\n"
+"<script>\n"
+"var frame = -1, busy = false, down = false;\n"
+"function cmd(c, v, x, y) {\n"
+"  return fetch('/cmd?c=' + c + '&v=' + (v|0) + '&x=' + (x|0) +\n"
+"               '&y=' + (y|0)).then(poll);\n"
+"}\n"
+"function poll() {\n"
+"  if(busy) return; busy = true;\n"
+"  fetch('/state').then(r => r.json()).then(s => {\n"
+"    status.textContent = s.status.join('\\n');\n"
+"    if(s.frame != frame){\n"
+"      frame = s.frame;\n"
+"      v0.src = '/view/0.png?f=' + frame;\n"
+"      v1.src = '/view/1.png?f=' + frame;\n"
+"    }\n"
+"  }).finally(() => busy = false);\n"
+"}\n"
+"[v0, v1].forEach((img, v) => {\n"
+"  img.ondragstart = e => false;\n"
+"  img.onmousedown = e => { down = true; cmd('press', v, e.offsetX, e.offsetY); };\n"
+"  img.onmouseup = e => down = false;\n"
+"  img.onmousemove = e =>\n"
+"    cmd(down? 'drag': 'hover', v, e.offsetX, e.offsetY);\n"
+"  img.onwheel = e => { e.preventDefault();\n"
+"    cmd(e.deltaY < 0? 'zoomin': 'zoomout', v, e.offsetX, e.offsetY); };\n"
+"});\n"
+"setInterval(poll, 100);\n"
+"</script></body></html>\n";
+
+void serve_enable(const int p)
+{
+  port = p;
+}
+
+bool serving()
+{
+  return port != 0;
+}
+
+static cairo_status_t append_png(void * closure, const unsigned char * data,
+                                 unsigned int length)
+{
+  ((std::string *)closure)->append((const char *)data, length);
+  return CAIRO_STATUS_SUCCESS;
+}
+
+// Append 's' to 'out' as a JSON string
+static void append_json_string(std::string & out, const char * s)
+{
+  out += '"';
+  for(; *s; s++){
+    if(*s == '"' || *s == '\\') out += '\\', out += *s;
+    else if((unsigned char)*s < 0x20) out += ' ';
+    else out += *s;
+  }
+  out += '"';
+}
+
+// Get the integer value of 'key' from a query string like "a=1&b=2", or
+// zero if it isn't there.
+static int query_int(const char * query, const char * const key)
+{
+  const int len = strlen(key);
+  for(const char * p = query; p != NULL && *p; p = strchr(p, '&')){
+    if(*p == '&') p++;
+    if(!strncmp(p, key, len) && p[len] == '=') return atoi(p + len + 1);
+  }
+  return 0;
+}
+
+// Like query_int, but for a string, put into 'buf'
+static void query_string(const char * query, const char * const key,
+                         char * const buf, const int buflen)
+{
+  buf[0] = '\0';
+  const int len = strlen(key);
+  for(const char * p = query; p != NULL && *p; p = strchr(p, '&')){
+    if(*p == '&') p++;
+    if(!strncmp(p, key, len) && p[len] == '='){
+      const char * end = strchr(p + len + 1, '&');
+      if(end == NULL) end = p + len + 1 + strlen(p + len + 1);
+      snprintf(buf, buflen, "%.*s", (int)(end - (p + len + 1)), p + len + 1);
+      return;
+    }
+  }
+}
+
+// Make the response for the given path and query string.  Returns the HTTP
+// status code.
+static int respond(const char * const path, const char * const query,
+                   std::string & body, const char * & type)
+{
+  type = "text/plain";
+
+  if(!strcmp(path, "/")){
+    type = "text/html";
+    body = page;
+    return 200;
+  }
+
+  int V;
+  if(sscanf(path, "/view/%d.png", &V) == 1 && V >= 0 && V < kXorY){
+    if(offscreen[V] == NULL) return 404;
+    type = "image/png";
+    cairo_surface_write_to_png_stream(offscreen[V], append_png, &body);
+    return 200;
+  }
+
+  if(!strcmp(path, "/state")){
+    type = "application/json";
+    char buf[32];
+    snprintf(buf, sizeof buf, "{\"frame\": %u, ", present_count());
+    body = buf;
+    body += "\"status\": [";
+    const int lines[] = { statrunevent, stattiming, stathit, staterror,
+                          stattrack, statvertex };
+    for(unsigned int i = 0; i < sizeof lines/sizeof lines[0]; i++){
+      if(i) body += ", ";
+      append_json_string(body, get_status(lines[i]));
+    }
+    body += "]}\n";
+    return 200;
+  }
+
+  if(!strcmp(path, "/cmd")){
+    char cmd[32];
+    query_string(query, "c", cmd, sizeof cmd);
+    if(!serve_command(cmd, query_int(query, "v"), query_int(query, "x"),
+                      query_int(query, "y"))){
+      body = "unknown command\n";
+      return 400;
+    }
+    body = "ok\n";
+    return 200;
+  }
+
+  body = "not found\n";
+  return 404;
+}
+
+// A request passed from a connection's thread to the main thread, and the
+// response passed back
+struct request_t{
+  char target[1024];
+  std::string body;
+  const char * type;
+  int code;
+  bool done;
+};
+
+static GMutex respondlock;
+static GCond responded;
+
+// Run on the main thread, since it looks at the event and the views
+static gboolean respond_on_main(gpointer data)
+{
+  request_t * const r = (request_t *)data;
+
+  trace_begin("serve");
+  char * const q = strchr(r->target, '?');
+  if(q != NULL) *q = '\0';
+  const int code = respond(r->target, q == NULL? "": q+1, r->body, r->type);
+  trace_end("serve");
+
+  g_mutex_lock(&respondlock);
+  r->code = code;
+  r->done = true;
+  g_cond_broadcast(&responded);
+  g_mutex_unlock(&respondlock);
+  return FALSE;
+}
+
+// Run on a thread of its own for each connection, so it can wait on the
+// client as long as it likes
+static gboolean incoming(__attribute__((unused))
+                           GThreadedSocketService * service,
+                         GSocketConnection * conn,
+                         __attribute__((unused)) GObject * source,
+                         __attribute__((unused)) gpointer data)
+{
+  // Don't let a stuck client hold a thread forever
+  g_socket_set_timeout(g_socket_connection_get_socket(conn), 5);
+
+  GDataInputStream * const in =
+    g_data_input_stream_new(g_io_stream_get_input_stream(G_IO_STREAM(conn)));
+
+  char * const request = g_data_input_stream_read_line(in, NULL, NULL, NULL);
+
+  // Skip the headers
+  char * line;
+  while((line = g_data_input_stream_read_line(in, NULL, NULL, NULL)) != NULL){
+    const bool end = line[0] == '\0' || !strcmp(line, "\r");
+    g_free(line);
+    if(end) break;
+  }
+
+  request_t r;
+  r.type = "text/plain";
+  r.code = 400;
+  r.done = true;
+  if(request != NULL && sscanf(request, "GET %1023s", r.target) == 1){
+    r.done = false;
+    g_idle_add_full(G_PRIORITY_DEFAULT, respond_on_main, &r, NULL);
+
+    g_mutex_lock(&respondlock);
+    while(!r.done) g_cond_wait(&responded, &respondlock);
+    g_mutex_unlock(&respondlock);
+  }
+  g_free(request);
+
+  char header[256];
+  snprintf(header, sizeof header, "HTTP/1.0 %d %s\r\n"
+           "Content-Type: %s\r\nContent-Length: %u\r\n"
+           "Cache-Control: no-store\r\nConnection: close\r\n\r\n",
+           r.code, r.code == 200? "OK": r.code == 404? "Not Found":
+           "Bad Request", r.type, (unsigned int)r.body.size());
+
+  GOutputStream * const out =
+    g_io_stream_get_output_stream(G_IO_STREAM(conn));
+  g_output_stream_write_all(out, header, strlen(header), NULL, NULL, NULL);
+  g_output_stream_write_all(out, r.body.data(), r.body.size(),
+                            NULL, NULL, NULL);
+
+  g_object_unref(in);
+  return TRUE;
+}
+
+bool serve_start()
+{
+  // The page fetches both views and the state at once
+  GSocketService * const service = g_threaded_socket_service_new(4);
+  GInetAddress * const lo = g_inet_address_new_loopback(G_SOCKET_FAMILY_IPV4);
+  GSocketAddress * const addr = g_inet_socket_address_new(lo, port);
+
+  GError * err = NULL;
+  const bool ok = g_socket_listener_add_address(G_SOCKET_LISTENER(service),
+    addr, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, NULL, NULL, &err);
+  g_object_unref(addr);
+  g_object_unref(lo);
+
+  if(!ok){
+    fprintf(stderr, "NOE: could not listen on port %d: %s\n", port,
+            err->message);
+    g_error_free(err);
+    return false;
+  }
+
+  g_signal_connect(service, "run", G_CALLBACK(incoming), NULL);
+  g_socket_service_start(service);
+  printf("NOE: Point your browser at http://localhost:%d/\n", port);
+  fflush(stdout);
+  return true;
+}
@@ -0,0 +1,13 @@
+// Serve the event display to a web browser on the given port of localhost
+// instead of opening windows.  Off by default.
+void serve_enable(const int port);
+bool serving();
+
+// Start listening.  Returns false if that fails.
+bool serve_start();
+
+// Carry out a command from the browser, e.g. "next" or "zoom".  The meaning
+// of v, x and y depend on the command.  Returns false if the command isn't
+// known.  Defined in main.cxx, where the handlers are.
+bool serve_command(const char * const cmd, const int v, const int x,
+                   const int y);
@@ -7,6 +7,11 @@
 #include <vector>
 #include "event.h"
 #include "status.h"
+#include "geo.h"
+#include "drawing.h"
+#include "merge.h"
+#include "perf.h"
+#include "trace.h"
 
 GtkTextBuffer * stattext[NSTATBOXES];
 GtkWidget * statbox[NSTATBOXES];
@@ -26,16 +31,34 @@ static const int MAXSTATUS = 1024;
 #define BOTANY_BAY_OH_NO(x) x < 0?"−":"", fabs(x)
 #define BOTANY_BAY_OH_INT(x) x < 0?"−":"", abs((int)x)
 
+// The current text of each status line, also kept here for when there are
+// no GTK widgets to keep it
+static char statline[NSTATBOXES][MAXSTATUS];
+
+const char * get_status(const int boxn)
+{
+  return statline[boxn];
+}
+
 void set_status(const int boxn, const char * format, ...)
 {
+  trace_begin("set_status");
   va_list ap;
   va_start(ap, format);
-  static char buf[MAXSTATUS];
+  char * const buf = statline[boxn];
   vsnprintf(buf, MAXSTATUS-1, format, ap);
+  va_end(ap);
+
+  // No GUI, as when drawing offscreen for benchmarks or serving to a browser
+  if(stattext[boxn] == NULL){
+    trace_end("set_status");
+    return;
+  }
 
   gtk_text_buffer_set_text(stattext[boxn], buf, strlen(buf));
   gtk_text_view_set_buffer(GTK_TEXT_VIEW(statbox[boxn]), stattext[boxn]);
   gtk_widget_draw(statbox[boxn], NULL);
+  trace_end("set_status");
 }
 
 void set_eventn_status_runevent()
@@ -45,6 +68,18 @@ void set_eventn_status_runevent()
     return;
   }
 
+  const int nmerged = merge_count();
+  if(nmerged > 1){
+    const noeevent & last = theevents[gevi + nmerged - 1];
+    set_status(statrunevent, "Run %'d, subrun %d, event %'d through run %'d, "
+                  "subrun %d, event %'d merged "
+                  "(%'d-%'d/%'d in the file(s), %.0f%% loaded)",
+      theevents[gevi].nrun, theevents[gevi].nsubrun, theevents[gevi].nevent,
+      last.nrun, last.nsubrun, last.nevent, gevi+1, gevi+nmerged,
+      (int)theevents.capacity(), 100*float(theevents.size())/theevents.capacity());
+    return;
+  }
+
   set_status(statrunevent, "Run %'d, subrun %d, event %'d "
                 "(%'d/%'d in the file(s), %.0f%% loaded)",
     theevents[gevi].nrun, theevents[gevi].nsubrun,
@@ -54,13 +89,18 @@ void set_eventn_status_runevent()
 
 void set_eventn_status_timing()
 {
-  noeevent & E = theevents[gevi];
+  noeevent & E = shown_event();
 
   char status1[MAXSTATUS];
 
   int pos = snprintf(status1, MAXSTATUS, "Ticks %s%d through %d.  ",
              BOTANY_BAY_OH_INT(E.mintick), E.maxtick);
-  if(E.current_mintick != E.current_maxtick)
+  if(E.current_by_tns)
+    pos += snprintf(status1+pos, MAXSTATUS-pos,
+      "Showing TNS %s%.1f through %s%.1f ns",
+      BOTANY_BAY_OH_NO(E.current_mintns),
+      BOTANY_BAY_OH_NO(E.current_maxtns));
+  else if(E.current_mintick != E.current_maxtick)
     pos += snprintf(status1+pos, MAXSTATUS-pos,
       "Showing ticks %s%d through %s%d (%s%.3f through %s%.3f μs)",
       BOTANY_BAY_OH_INT(E.current_mintick),
@@ -107,6 +147,9 @@ void set_eventn_status_hit()
             BOTANY_BAY_OH_NO (THEhits[i].tns/1000),
             THEhits[i].good_tns?"":"(bad)",
             BOTANY_BAY_OH_INT(THEhits[i].adc));
+        if(THEhits[i].slice > 0)
+          pos += pos >= MAXSTATUS?0:snprintf(status2+pos, MAXSTATUS-pos,
+              ", slice %d", THEhits[i].slice);
         needseparator = true;
       }
       else if(matches == maxmatches+1){
@@ -175,6 +218,13 @@ void set_eventn_status_progress(const int nhit, const int tothits)
   set_status(stathit, "Processing big event, %d/%d hits", nhit, tothits);
 }
 
+void set_eventn_status_perf()
+{
+  char status[MAXSTATUS];
+  perf_summary(status, MAXSTATUS);
+  set_status(statperf, status);
+}
+
 void set_eventn_status()
 {
   set_eventn_status_runevent();
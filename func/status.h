@@ -5,6 +5,7 @@ enum statcontents {
   staterror,
   stattrack,
   statvertex,
+  statperf,
   NSTATBOXES
 };
 
@@ -12,6 +13,9 @@ enum statcontents {
 // Set the 'boxn'th status line to the given text, counted from zero.
 void set_status(const int boxn, const char * format, ...);
 
+// Get the current text of the 'boxn'th status line
+const char * get_status(const int boxn);
+
 // Set the zeroth status line to its standard contents -- run number, subrun
 // number, event number, number of events in the file.
 void set_eventn_status_runevent();
@@ -33,5 +37,8 @@ void set_eventn_status_vertex();
 // while doing a long computation.
 void set_eventn_status_progress(const int nhit, const int tothits);
 
+// Set the performance status line to a summary of recent timings
+void set_eventn_status_perf();
+
 // Set all status lines to their standard contents.
 void set_eventn_status();
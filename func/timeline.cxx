@@ -0,0 +1,155 @@
+/* timeline.cxx: A histogram of hit times for the shown event, so that the
+ * user can see where the activity is and select it instead of animating
+ * through long empty stretches.
+ *
+ * Each event has an array of the number of hits before each tick, made
+ * when it is read (see tickprefix in event.h), so any range's count is a
+ * difference of two entries, and the strip is drawn in time proportional to
+ * its width no matter how many hits or ticks there are.  In spill mode, only
+ * the events whose ticks overlap a range are counted.  They are found by
+ * binary search in two small arrays made from the events' tick ranges. */
+
+#include <gtk/gtk.h>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <math.h>
+#include "event.h"
+#include "geo.h"
+#include "drawing.h"
+#include "merge.h"
+#include "timeline.h"
+
+extern std::vector<noeevent> theevents;
+extern int gevi;
+
+// The selection being dragged out, in ticks
+static bool selecting = false;
+static int32_t selectstart = 0, selectend = 0;
+
+// For spill mode, where the merged events are on the merged timeline:
+// latestend[k] is the latest last tick of events 0 through k, and
+// earlieststart[k] the earliest first tick of events k onwards, so both
+// only ever go up.  Made from the events' tick ranges, not their hits, when
+// the merged events change: 'spancount' of them from theevents[spanfirst].
+static std::vector<int32_t> latestend, earlieststart;
+static int spanfirst = -1, spancount = 0;
+
+static void index_spans()
+{
+  const int n = merge_count();
+  if(spanfirst == gevi && spancount == n) return;
+  spanfirst = gevi, spancount = n;
+
+  latestend.resize(n);
+  earlieststart.resize(n);
+  for(int k = 0; k < n; k++){
+    const noeevent & E = theevents[gevi+k];
+    const int32_t end = E.hits.empty()? INT32_MIN: E.maxtick + merge_offset(k);
+    latestend[k] = k == 0? end: std::max(latestend[k-1], end);
+  }
+  for(int k = n-1; k >= 0; k--){
+    const noeevent & E = theevents[gevi+k];
+    const int32_t start =
+      E.hits.empty()? INT32_MAX: E.mintick + merge_offset(k);
+    earlieststart[k] = k == n-1? start: std::min(earlieststart[k+1], start);
+  }
+}
+
+int hits_in_ticks(const int32_t lo, const int32_t hi)
+{
+  if(merge_count() == 1) return event_hits_in_ticks(theevents[gevi], lo, hi);
+
+  // Events before 'first' all end before lo, and those from 'last' on all
+  // start after hi
+  index_spans();
+  const int first = std::lower_bound(latestend.begin(), latestend.end(), lo)
+                  - latestend.begin();
+  const int last = std::upper_bound(earlieststart.begin(),
+                                    earlieststart.end(), hi)
+                 - earlieststart.begin();
+
+  int n = 0;
+  for(int k = first; k < last; k++){
+    const int32_t offset = merge_offset(k);
+    n += event_hits_in_ticks(theevents[gevi+k], lo - offset, hi - offset);
+  }
+  return n;
+}
+
+// The tick at x in a strip w pixels wide, and the reverse
+static int32_t tick_at(const int x, const int w)
+{
+  const noeevent & E = shown_event();
+  const int32_t t = E.mintick + (int64_t)x*(E.maxtick - E.mintick + 1)/w;
+  return std::max(E.mintick, std::min(E.maxtick, t));
+}
+
+static double x_of(const int32_t tick, const int w)
+{
+  const noeevent & E = shown_event();
+  return double(tick - E.mintick)*w/(E.maxtick - E.mintick + 1);
+}
+
+void draw_timeline(cairo_t * cr, const int w, const int h)
+{
+  cairo_set_source_rgb(cr, 0, 0, 0);
+  cairo_paint(cr);
+
+  if(theevents.empty() || w <= 0) return;
+  const noeevent & E = shown_event();
+  if(E.maxtick < E.mintick) return;
+
+  // The selected range, or the one being selected
+  const int32_t selmin = selecting? std::min(selectstart, selectend):
+                                    E.user_mintick;
+  const int32_t selmax = selecting? std::max(selectstart, selectend):
+                                    E.user_maxtick;
+  cairo_set_source_rgb(cr, 0.2, 0.2, 0.4);
+  cairo_rectangle(cr, x_of(selmin, w), 0,
+                  x_of(selmax + 1, w) - x_of(selmin, w), h);
+  cairo_fill(cr);
+
+  // Kept between calls to avoid allocating each time
+  static std::vector<int> counts;
+  counts.resize(w);
+  int maxcount = 1;
+  for(int x = 0; x < w; x++){
+    const int32_t lo = tick_at(x, w);
+    const int32_t hi = std::max(lo, tick_at(x+1, w) - 1);
+    counts[x] = hits_in_ticks(lo, hi);
+    maxcount = std::max(maxcount, counts[x]);
+  }
+
+  // On a log scale, since a few busy ticks would otherwise flatten the rest
+  cairo_set_source_rgb(cr, 0.6, 0.8, 1);
+  for(int x = 0; x < w; x++){
+    if(counts[x] == 0) continue;
+    const double bar = std::max(1.0, h*log1p(counts[x])/log1p(maxcount));
+    cairo_rectangle(cr, x, h - bar, 1, bar);
+  }
+  cairo_fill(cr);
+
+  // Where the animation is, if there is one
+  if(!selecting && E.current_maxtick < E.user_maxtick){
+    cairo_set_source_rgb(cr, 1, 0, 1);
+    cairo_rectangle(cr, floor(x_of(E.current_maxtick, w)), 0, 1, h);
+    cairo_fill(cr);
+  }
+}
+
+void timeline_select(const int x, const int w, const bool start)
+{
+  if(theevents.empty() || w <= 0) return;
+  if(start) selecting = true, selectstart = tick_at(x, w);
+  if(selecting) selectend = tick_at(x, w);
+}
+
+bool timeline_end_select(int32_t & lo, int32_t & hi)
+{
+  if(!selecting) return false;
+  selecting = false;
+  lo = std::min(selectstart, selectend);
+  hi = std::max(selectstart, selectend);
+  return true;
+}
@@ -0,0 +1,19 @@
+// The strip under the controls showing how many hits there are at each time
+// in the shown event, and the selected range of ticks.
+
+// Draw the strip, of size w by h
+void draw_timeline(cairo_t * cr, const int w, const int h);
+
+// The number of hits in the shown event with ticks from lo through hi.  In
+// spill mode, this counts the hits of all merged events on the merged
+// timeline.  Takes constant time for one event, and in spill mode, time
+// for each merged event whose ticks overlap the range.
+int hits_in_ticks(const int32_t lo, const int32_t hi);
+
+// Start (if 'start') or continue selecting a range of ticks by dragging
+// the mouse to x in a strip w pixels wide
+void timeline_select(const int x, const int w, const bool start);
+
+// Finish a selection, putting the range selected in lo and hi.  Returns
+// false if no selection was in progress.
+bool timeline_end_select(int32_t & lo, int32_t & hi);
@@ -0,0 +1,80 @@
+/* trace.cxx: Writes a record of when things happened for viewing in a trace
+ * viewer.  The format is documented in Google's "Trace Event Format". */
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "trace.h"
+
+static FILE * tracefile = NULL;
+static bool firstevent = true;
+
+// Microseconds, which is the unit of trace files
+static double now_us()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e6 + ts.tv_nsec*1e-3;
+}
+
+void trace_open(const char * const filename)
+{
+  if((tracefile = fopen(filename, "w")) == NULL){
+    fprintf(stderr, "NOE: could not open trace file \"%s\"\n", filename);
+    return;
+  }
+  fprintf(tracefile, "[\n");
+}
+
+void trace_close()
+{
+  if(tracefile == NULL) return;
+  fprintf(tracefile, "\n]\n");
+  fclose(tracefile);
+  tracefile = NULL;
+}
+
+bool tracing()
+{
+  return tracefile != NULL;
+}
+
+void trace_flush()
+{
+  if(tracefile != NULL) fflush(tracefile);
+}
+
+// Write one event.  Viewers are happy with a file that is cut off without
+// the closing bracket, so events can be written as they happen.  See
+// trace_flush().
+static void trace_event(const char * const name, const char phase,
+                        const bool async)
+{
+  if(tracefile == NULL) return;
+  fprintf(tracefile,
+    "%s{\"name\":\"%s\",\"cat\":\"noe\",\"ph\":\"%c\",\"ts\":%.3f,"
+    "\"pid\":%d,\"tid\":1%s}",
+    firstevent?"":",\n", name, phase, now_us(), (int)getpid(),
+    async?",\"id\":1":"");
+  firstevent = false;
+}
+
+void trace_begin(const char * const name)
+{
+  trace_event(name, 'B', false);
+}
+
+void trace_end(const char * const name)
+{
+  trace_event(name, 'E', false);
+}
+
+void trace_async_begin(const char * const name)
+{
+  trace_event(name, 'b', true);
+}
+
+void trace_async_end(const char * const name)
+{
+  trace_event(name, 'e', true);
+}
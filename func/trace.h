@@ -0,0 +1,22 @@
+// Start writing a trace of what NOE is doing to the named file, in the
+// JSON trace event format that chrome://tracing and Perfetto read.
+void trace_open(const char * const filename);
+
+// Finish the trace file.  Must be called before exiting, or some of the
+// trace may be lost.
+void trace_close();
+
+bool tracing();
+
+// Write out anything buffered, so that it survives if we are killed
+void trace_flush();
+
+// Mark the beginning and end of a span of time on the main thread.  Spans
+// with the same name must not overlap, and spans must nest.
+void trace_begin(const char * const name);
+void trace_end(const char * const name);
+
+// Mark the beginning and end of a span of time that does not nest with the
+// others, e.g. one that starts inside the GTK loop and ends outside of it.
+void trace_async_begin(const char * const name);
+void trace_async_end(const char * const name);
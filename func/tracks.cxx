@@ -1,74 +1,233 @@
 #include <gtk/gtk.h>
 #include <vector>
 #include <stdint.h>
+#include <limits.h>
+#include <algorithm>
 #include "event.h"
 #include "geo.h"
+#include "absgeo.h"
 #include "drawing.h"
+#include "active.h"
 #include "tracks.h"
+#include "layers.h"
 
 extern std::vector<noeevent> theevents;
 extern std::vector<screentrack_t> screentracks[kXorY];
 extern int gevi;
 extern int pixx, pixy;
+extern bool isfd;
 extern int active_track;
 
-// Draws one track in the view that 'cr' is attached to (so must
-// be passed the correct 'traj') and returns all of the computed screen
-// track point positions.  If 'active', draw it highlighted as the active
-// track.
-static std::vector< std::pair<int, int> >
-draw_track_in_one_view(cairo_t * cr,
-                       const std::vector<cppoint> & traj,
-                       const bool active)
-{
-  std::vector< std::pair<int, int> > screenpoints;
-  if(traj.size() < 2) return screenpoints;
+// The event, zoom and detector that screentracks was filled in for
+static int placedevent = -1, placedpixx = 0, placedpixy = 0;
+static bool placedfd = false;
 
-  for(unsigned int h = 0; h < traj.size(); h++)
-    screenpoints.push_back(cppoint_to_screen(traj[h]));
+// How far, in pixels, a simplified track may stray from the full one.  Well
+// under the width of the line, so that the difference can't be seen.
+static const float SIMPLIFY = 0.5;
 
+static void set_track_style(cairo_t * cr, const bool active)
+{
   if(active) cairo_set_source_rgb(cr, 1, 0, 0);
   else       cairo_set_source_rgb(cr, 0, 0.9, 0.9);
 
   cairo_set_line_width(cr, active?2.5:1.5);
+  cairo_set_line_join(cr, CAIRO_LINE_JOIN_ROUND);
+}
 
+// Add a track whose screen positions have already been computed to the
+// current path, to be stroked along with others of the same style.  The
+// pan offsets to subtract are dx and dy.
+static void trace_track(cairo_t * cr, const screentrack_t & st,
+                        const int dx, const int dy)
+{
   /* Do not try to optimize by not drawing track segments that are entirely out
      of the view, because I don't want to do the work, and I suspect the
      performance advantage is small in most cases (but haven't checked). */
-  for(unsigned int h = 1; h < screenpoints.size(); h++){
-    cairo_move_to(cr, screenpoints[h-1].first, screenpoints[h-1].second);
-    cairo_line_to(cr, screenpoints[h].first, screenpoints[h].second);
-    cairo_stroke(cr);
+  if(st.x.empty()) return;
+  cairo_move_to(cr, st.x[0] - dx, st.y[0] - dy);
+  for(unsigned int h = 1; h < st.x.size(); h++)
+    cairo_line_to(cr, st.x[h] - dx, st.y[h] - dy);
+}
+
+// The square of the distance from (x, y) to the segment from a to b of the
+// track, using the same kernel as for picking out tracks with the mouse
+static float dist2_to_segment(const screentrack_t & st, const unsigned int a,
+                              const unsigned int b, const float x,
+                              const float y)
+{
+  const float tx[2] = { st.x[a], st.x[b] }, ty[2] = { st.y[a], st.y[b] };
+  return screen_dist2_to_track(x, y, tx, ty, 2);
+}
+
+// Drop the trajectory points that don't change how the track looks at the
+// current zoom: first those on the same pixel as the one before, then, by
+// the Douglas-Peucker method, those within SIMPLIFY of the line between the
+// points kept on either side.  Zoomed out, a track with thousands of
+// points comes down to a handful.
+static void simplify_track(screentrack_t & st)
+{
+  unsigned int n = 1;
+  for(unsigned int h = 1; h < st.x.size(); h++){
+    if(st.x[h] == st.x[n-1] && st.y[h] == st.y[n-1]) continue;
+    st.x[n] = st.x[h], st.y[n] = st.y[h], n++;
+  }
+
+  // Keep a track that is all on one pixel as a segment so that it can still
+  // be picked out with the mouse
+  n = std::max(2u, n);
+  st.x.resize(n), st.y.resize(n);
+  if(n < 3) return;
+
+  // Kept between tracks to avoid allocating for each one
+  static std::vector<char> keep;
+  static std::vector<std::pair<unsigned int, unsigned int> > todo;
+  keep.assign(n, false);
+  keep[0] = keep[n-1] = true;
+  todo.clear();
+  todo.push_back(std::make_pair(0u, n-1));
+
+  while(!todo.empty()){
+    const unsigned int a = todo.back().first, b = todo.back().second;
+    todo.pop_back();
+
+    float far2 = SIMPLIFY*SIMPLIFY;
+    unsigned int farthest = 0;
+    for(unsigned int h = a+1; h < b; h++){
+      const float d2 = dist2_to_segment(st, a, b, st.x[h], st.y[h]);
+      if(d2 > far2) far2 = d2, farthest = h;
+    }
+    if(farthest == 0) continue;
+
+    keep[farthest] = true;
+    todo.push_back(std::make_pair(a, farthest));
+    todo.push_back(std::make_pair(farthest, b));
+  }
+
+  unsigned int kept = 0;
+  for(unsigned int h = 0; h < n; h++)
+    if(keep[h]) st.x[kept] = st.x[h], st.y[kept] = st.y[h], kept++;
+  st.x.resize(kept), st.y.resize(kept);
+}
+
+// Fills 'st' with the screen positions of a track in view V, less the pan
+// offsets, given its 'traj' for that view, simplified for the current zoom.
+static void place_track(screentrack_t & st, const std::vector<cppoint> & traj,
+                        const int V)
+{
+  st.unpannedbox.xmin = st.unpannedbox.ymin = 0;
+  st.unpannedbox.xsize = st.unpannedbox.ysize = 0;
+  st.x.clear(), st.y.clear();
+  if(traj.size() < 2) return;
+
+  const int dx = pan_x(), dy = pan_y((noe_view_t)V);
+  st.x.resize(traj.size());
+  st.y.resize(traj.size());
+  int xmin = INT_MAX, ymin = INT_MAX, xmax = INT_MIN, ymax = INT_MIN;
+  for(unsigned int h = 0; h < traj.size(); h++){
+    const std::pair<int, int> sp = cppoint_to_screen(traj[h]);
+    const int x = sp.first + dx, y = sp.second + dy;
+    st.x[h] = x;
+    st.y[h] = y;
+    xmin = std::min(xmin, x); xmax = std::max(xmax, x);
+    ymin = std::min(ymin, y); ymax = std::max(ymax, y);
   }
 
-  return screenpoints;
+  // Enough to cover the width of the highlighted line plus antialiasing
+  const int margin = 3;
+  st.unpannedbox.xmin = xmin - margin;
+  st.unpannedbox.ymin = ymin - margin;
+  st.unpannedbox.xsize = xmax - xmin + 2*margin + 1;
+  st.unpannedbox.ysize = ymax - ymin + 2*margin + 1;
+
+  simplify_track(st);
 }
 
-void draw_tracks(cairo_t ** cr, const DRAWPARS * const drawpars)
+// Fill in screentracks for the current event and zoom, unless it already
+// is.  Panning doesn't change anything in it.  Keeps the arrays of the
+// previous tracks to avoid allocating.
+static void place_tracks()
 {
+  const std::vector<track> & tracks = theevents[gevi].tracks;
+  if(placedevent == gevi && placedpixx == pixx && placedpixy == pixy &&
+     placedfd == isfd && screentracks[kX].size() == tracks.size()) return;
+
   for(int V = 0; V < kXorY; V++){
-    if(drawpars->clear) screentracks[V].clear();
-
-    for(unsigned int i = 0; i < theevents[gevi].tracks.size(); i++){
-      track & tr = theevents[gevi].tracks[i];
-      if((int)i != active_track &&
-         tr.time >= drawpars->firsttick && tr.time <= drawpars->lasttick){
-        screentrack_t st;
-        st.traj = draw_track_in_one_view(cr[V], tr.traj[V], false);
-        st.i = i;
-        screentracks[V].push_back(st);
-      }
+    screentracks[V].resize(tracks.size());
+    for(unsigned int i = 0; i < tracks.size(); i++){
+      screentrack_t & st = screentracks[V][i];
+      place_track(st, tracks[i].traj[V], V);
+      st.i = i;
+      st.shown = false;
     }
+  }
+
+  placedevent = gevi, placedpixx = pixx, placedpixy = pixy, placedfd = isfd;
+}
+
+// Mark a track as on the screen and find where it is with the current pan
+// offsets dx and dy
+static void show_track(screentrack_t & st, const int dx, const int dy)
+{
+  st.shown = true;
+  st.box = st.unpannedbox;
+  st.box.xmin -= dx;
+  st.box.ymin -= dy;
+}
+
+void redraw_tracks(cairo_t * cr, const int V, const rect & area,
+                   const int layer)
+{
+  const int dx = pan_x(), dy = pan_y((noe_view_t)V);
+  const std::vector<track> & tracks = theevents[gevi].tracks;
+  for(unsigned int i = 0; i < screentracks[V].size(); i++){
+    const screentrack_t & st = screentracks[V][i];
+    if(st.shown && st.i != active_track && tracks[i].layer == layer &&
+       st.box.overlaps(area)) trace_track(cr, st, dx, dy);
+  }
+  set_track_style(cr, false);
+  cairo_stroke(cr);
+}
 
-    // Draw the active track last so it is on top
-    if(active_track >= 0){
-      track & tr = theevents[gevi].tracks[active_track];
-      if(tr.time >= drawpars->firsttick && tr.time <= drawpars->lasttick){
-        screentrack_t st;
-        st.traj = draw_track_in_one_view(cr[V], tr.traj[V], true);
-        st.i = active_track;
-        screentracks[V].push_back(st);
-      }
+void draw_tracks(cairo_t ** cr, const DRAWPARS * const drawpars,
+                 const int layer)
+{
+  convert_reco(theevents[gevi]);
+  place_tracks();
+
+  const std::vector<track> & tracks = theevents[gevi].tracks;
+  for(int V = 0; V < kXorY; V++){
+    const int dx = pan_x(), dy = pan_y((noe_view_t)V);
+    std::vector<screentrack_t> & sts = screentracks[V];
+
+    if(drawpars->clear)
+      for(unsigned int i = 0; i < sts.size(); i++)
+        if(tracks[i].layer == layer) sts[i].shown = false;
+
+    // The active track is shown, but by draw_active_track()
+    for(unsigned int i = 0; i < tracks.size(); i++){
+      const track & tr = tracks[i];
+      if(tr.layer != layer || !drawpars->shows(tr.time, tr.tns)) continue;
+      show_track(sts[i], dx, dy);
+      if((int)i != active_track) trace_track(cr[V], sts[i], dx, dy);
     }
+    set_track_style(cr[V], false);
+    cairo_stroke(cr[V]);
+  }
+}
+
+void draw_active_track(cairo_t ** cr)
+{
+  const std::vector<track> & tracks = theevents[gevi].tracks;
+  if(active_track < 0 || active_track >= (int)tracks.size() ||
+     !layer_enabled(tracks[active_track].layer)) return;
+
+  for(int V = 0; V < kXorY; V++){
+    if(active_track >= (int)screentracks[V].size()) continue;
+    const screentrack_t & st = screentracks[V][active_track];
+    if(!st.shown) continue;
+    trace_track(cr[V], st, pan_x(), pan_y((noe_view_t)V));
+    set_track_style(cr[V], true);
+    cairo_stroke(cr[V]);
   }
 }
@@ -1,12 +1,34 @@
 struct screentrack_t {
-  // positions of trajectory points in pixels
-  std::vector< std::pair<int, int> > traj;
+  // positions of trajectory points in pixels, as separate x and y arrays
+  // so that distances to the track can be computed quickly.  These leave
+  // out the pan offsets (see pan_x() in geo.h), so only need to be worked
+  // out again on zooming or going to another event.
+  std::vector<float> x, y;
 
-  // index into the full track array. If all tracks are displayed, it is
-  // one-to-one, otherwise not.
+  // The area of the screen the track is drawn on, including line width, as
+  // of when it was last drawn, and the same without the pan offsets
+  rect box, unpannedbox;
+
+  // Whether the track is on the screen, i.e. in the range of times shown
+  bool shown;
+
+  // index into the full track array, which is also this one's index in
+  // screentracks
   int i;
 };
 
-// Given cairo's for both views, draw all the tracks and cache the
-// screen positions for mouseovers.
-void draw_tracks(cairo_t ** cr, const DRAWPARS * const drawpars);
+// Given cairo's for both views, draw all the tracks in the given layer
+// (see layers.h) but the active one, and cache the screen positions of all
+// of them for mouseovers.  The caller must then call index_screentracks().
+void draw_tracks(cairo_t ** cr, const DRAWPARS * const drawpars,
+                 const int layer);
+
+// Draw again the tracks of the given layer that are already on the screen
+// of view V, as recorded in screentracks, but only those that overlap
+// 'area', and not the active one
+void redraw_tracks(cairo_t * cr, const int V, const rect & area,
+                   const int layer);
+
+// Draw the active track, highlighted, where it is on the screen, if it is
+// and its layer is enabled
+void draw_active_track(cairo_t ** cr);
@@ -4,72 +4,148 @@
 #include "event.h"
 #include "geo.h"
 #include "drawing.h"
+#include "active.h"
 #include "vertices.h"
+#include "layers.h"
 
 extern std::vector<noeevent> theevents;
 extern std::vector<screenvertex_t> screenvertices[kXorY];
 extern int gevi;
 extern int pixx, pixy;
+extern bool isfd;
 extern int active_vertex;
 
-static std::pair<int, int> draw_vertex_in_one_view(cairo_t * cr,
-                                                   const cppoint & pos,
-                                                   const bool active)
-{
-  std::pair<int, int> screenpoint = cppoint_to_screen(pos);
+// The event, zoom and detector that screenvertices was filled in for
+static int placedevent = -1, placedpixx = 0, placedpixy = 0;
+static bool placedfd = false;
+
+static const int starsize = 6;
 
+static void set_vertex_style(cairo_t * cr, const bool active)
+{
   if(active) cairo_set_source_rgb(cr, 1.0, 0.5, 0.5);
   else       cairo_set_source_rgb(cr, 0.8, 0.0, 0.8);
   cairo_set_line_width(cr, 1);
+}
 
+// Add the star of a vertex whose screen position has already been computed
+// to the current path, to be stroked along with others of the same style.
+// The pan offsets to subtract are dx and dy.
+static void trace_vertex(cairo_t * cr, const std::pair<int, int> & screenpoint,
+                         const int dx, const int dy)
+{
   // As with tracks, don't bother checking if we're in view since drawing is
   // fairly cheap.
+  const float x = screenpoint.first - dx + 0.5,
+              y = screenpoint.second - dy + 0.5;
 
-  const int starsize = 6;
+  cairo_move_to(cr, x-starsize, y-starsize);
+  cairo_line_to(cr, x+starsize, y+starsize);
 
-  cairo_move_to(cr, screenpoint.first-starsize+0.5, screenpoint.second-starsize+0.5);
-  cairo_line_to(cr, screenpoint.first+starsize+0.5, screenpoint.second+starsize+0.5);
-  cairo_stroke(cr);
+  cairo_move_to(cr, x+starsize, y-starsize);
+  cairo_line_to(cr, x-starsize, y+starsize);
 
-  cairo_move_to(cr, screenpoint.first+starsize+0.5, screenpoint.second-starsize+0.5);
-  cairo_line_to(cr, screenpoint.first-starsize+0.5, screenpoint.second+starsize+0.5);
-  cairo_stroke(cr);
+  cairo_move_to(cr, x-starsize, y);
+  cairo_line_to(cr, x+starsize, y);
 
-  cairo_move_to(cr, screenpoint.first-starsize+0.5, screenpoint.second+0.5);
-  cairo_line_to(cr, screenpoint.first+starsize+0.5, screenpoint.second+0.5);
-  cairo_stroke(cr);
+  cairo_move_to(cr, x, y-starsize);
+  cairo_line_to(cr, x, y+starsize);
+}
 
-  cairo_move_to(cr, screenpoint.first+0.5, screenpoint.second-starsize+0.5);
-  cairo_line_to(cr, screenpoint.first+0.5, screenpoint.second+starsize+0.5);
-  cairo_stroke(cr);
+// Fill in screenvertices for the current event and zoom, unless it already
+// is.  As for tracks, panning doesn't change anything in it.
+static void place_vertices()
+{
+  const std::vector<vertex> & vertices = theevents[gevi].vertices;
+  if(placedevent == gevi && placedpixx == pixx && placedpixy == pixy &&
+     placedfd == isfd && screenvertices[kX].size() == vertices.size()) return;
+
+  for(int V = 0; V < kXorY; V++){
+    screenvertices[V].resize(vertices.size());
+    const int dx = pan_x(), dy = pan_y((noe_view_t)V);
+    for(unsigned int i = 0; i < vertices.size(); i++){
+      screenvertex_t & sv = screenvertices[V][i];
+      sv.pos = cppoint_to_screen(vertices[i].pos[V]);
+      sv.pos.first += dx;
+      sv.pos.second += dy;
+
+      // The star plus a pixel of antialiasing on each side
+      sv.unpannedbox.xmin = sv.pos.first  - starsize - 1;
+      sv.unpannedbox.ymin = sv.pos.second - starsize - 1;
+      sv.unpannedbox.xsize = sv.unpannedbox.ysize = 2*starsize + 3;
+
+      sv.i = i;
+      sv.shown = false;
+    }
+  }
 
-  return screenpoint;
+  placedevent = gevi, placedpixx = pixx, placedpixy = pixy, placedfd = isfd;
 }
 
-void draw_vertices(cairo_t ** cr, const DRAWPARS * const drawpars)
+// Mark a vertex as on the screen and find where it is with the current pan
+// offsets dx and dy
+static void show_vertex(screenvertex_t & sv, const int dx, const int dy)
 {
+  sv.shown = true;
+  sv.box = sv.unpannedbox;
+  sv.box.xmin -= dx;
+  sv.box.ymin -= dy;
+}
+
+void redraw_vertices(cairo_t * cr, const int V, const rect & area,
+                     const int layer)
+{
+  const int dx = pan_x(), dy = pan_y((noe_view_t)V);
+  const std::vector<vertex> & vertices = theevents[gevi].vertices;
+  for(unsigned int i = 0; i < screenvertices[V].size(); i++){
+    const screenvertex_t & sv = screenvertices[V][i];
+    if(sv.shown && sv.i != active_vertex && vertices[i].layer == layer &&
+       sv.box.overlaps(area)) trace_vertex(cr, sv.pos, dx, dy);
+  }
+  set_vertex_style(cr, false);
+  cairo_stroke(cr);
+}
+
+void draw_vertices(cairo_t ** cr, const DRAWPARS * const drawpars,
+                   const int layer)
+{
+  convert_reco(theevents[gevi]);
+  place_vertices();
+
+  const std::vector<vertex> & vertices = theevents[gevi].vertices;
   for(int V = 0; V < kXorY; V++){
-    if(drawpars->clear) screenvertices[V].clear();
-    for(unsigned int i = 0; i < theevents[gevi].vertices.size(); i++){
-      vertex & vert = theevents[gevi].vertices[i];
-      if((int)i != active_vertex &&
-         vert.time >= drawpars->firsttick && vert.time <= drawpars->lasttick){
-        screenvertex_t sv;
-        sv.pos = draw_vertex_in_one_view(cr[V], vert.pos[V], false);
-        sv.i = i;
-        screenvertices[V].push_back(sv);
-      }
-    }
+    const int dx = pan_x(), dy = pan_y((noe_view_t)V);
+    std::vector<screenvertex_t> & svs = screenvertices[V];
+
+    if(drawpars->clear)
+      for(unsigned int i = 0; i < svs.size(); i++)
+        if(vertices[i].layer == layer) svs[i].shown = false;
 
-    // Draw the active vertex last so it is on top
-    if(active_vertex >= 0){
-      vertex & vert = theevents[gevi].vertices[active_vertex];
-      if(vert.time >= drawpars->firsttick && vert.time <= drawpars->lasttick){
-        screenvertex_t sv;
-        sv.pos = draw_vertex_in_one_view(cr[V], vert.pos[V], true);
-        sv.i = active_vertex;
-        screenvertices[V].push_back(sv);
-      }
+    // The active vertex is shown, but by draw_active_vertex()
+    for(unsigned int i = 0; i < vertices.size(); i++){
+      const vertex & vert = vertices[i];
+      if(vert.layer != layer || !drawpars->shows(vert.time, vert.tns))
+        continue;
+      show_vertex(svs[i], dx, dy);
+      if((int)i != active_vertex) trace_vertex(cr[V], svs[i].pos, dx, dy);
     }
+    set_vertex_style(cr[V], false);
+    cairo_stroke(cr[V]);
+  }
+}
+
+void draw_active_vertex(cairo_t ** cr)
+{
+  const std::vector<vertex> & vertices = theevents[gevi].vertices;
+  if(active_vertex < 0 || active_vertex >= (int)vertices.size() ||
+     !layer_enabled(vertices[active_vertex].layer)) return;
+
+  for(int V = 0; V < kXorY; V++){
+    if(active_vertex >= (int)screenvertices[V].size()) continue;
+    const screenvertex_t & sv = screenvertices[V][active_vertex];
+    if(!sv.shown) continue;
+    trace_vertex(cr[V], sv.pos, pan_x(), pan_y((noe_view_t)V));
+    set_vertex_style(cr[V], true);
+    cairo_stroke(cr[V]);
   }
 }
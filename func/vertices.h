@@ -1,11 +1,27 @@
 struct screenvertex_t {
-  // position in pixels
+  // position in pixels, leaving out the pan offsets as for screentrack_t
   std::pair<int, int> pos;
 
-  // index into the full vertex array. If all vertices are displayed, it is
-  // one-to-one, otherwise not.
+  // The area of the screen the vertex is drawn on as of when it was last
+  // drawn, and the same without the pan offsets
+  rect box, unpannedbox;
+
+  // Whether the vertex is on the screen, i.e. in the range of times shown
+  bool shown;
+
+  // index into the full vertex array, which is also this one's index in
+  // screenvertices
   int i;
 };
 
-void draw_vertices(cairo_t ** cr, const DRAWPARS * const drawpars);
+// As draw_tracks(), for vertices.  The caller must then call
+// index_screenvertices().
+void draw_vertices(cairo_t ** cr, const DRAWPARS * const drawpars,
+                   const int layer);
+
+// As redraw_tracks(), for vertices.
+void redraw_vertices(cairo_t * cr, const int V, const rect & area,
+                     const int layer);
 
+// As draw_active_track(), for vertices.
+void draw_active_vertex(cairo_t ** cr);
@@ -5,6 +5,7 @@
 #include "geo.h"
 #include "drawing.h"
 #include "zoompan.h"
+#include "replay.h"
 
 extern int pixx, pixy;
 extern int FDpixy, FDpixx;
@@ -16,12 +17,15 @@ extern int gevi;
 
 extern int screenxoffset, screenyoffset_xview, screenyoffset_yview;
 
+extern GtkWidget * edarea[kXorY];
+
 static int xonbutton1 = 0, yonbutton1 = 0;
 static int newbuttonpush = false;
-gboolean mousebuttonpress(__attribute__((unused)) GtkWidget * widg,
-                                 GdkEventMotion * gevent,
-                                 __attribute__((unused)) gpointer data)
+gboolean mousebuttonpress(GtkWidget * widg, GdkEventMotion * gevent,
+                          __attribute__((unused)) gpointer data)
 {
+  record_input(inpress, widg == edarea[kX]? kX: kY,
+               (int)gevent->x, (int)gevent->y);
   xonbutton1 = gevent->x;
   yonbutton1 = gevent->y;
   newbuttonpush = true;
@@ -52,11 +56,14 @@ static bool zoomed()
   return (isfd && pixx != FDpixx) || (!isfd && pixx != NDpixx);
 }
 
-gboolean dozooming(GtkWidget * widg, GdkEventScroll * gevent, gpointer data)
+gboolean dozooming(__attribute__((unused)) GtkWidget * widg,
+                   GdkEventScroll * gevent, gpointer data)
 {
   const bool up = gevent->direction == GDK_SCROLL_UP;
 
   const noe_view_t V = (*(bool *)data)?kY:kX;
+  record_input(inscroll, V, (int)gevent->x, (int)gevent->y, gevent->direction);
+
   int * yoffset       = V == kX?&screenyoffset_xview:&screenyoffset_yview;
   int * other_yoffset = V == kY?&screenyoffset_xview:&screenyoffset_yview;
 
@@ -70,7 +77,7 @@ gboolean dozooming(GtkWidget * widg, GdkEventScroll * gevent, gpointer data)
   // In the view *not* being moused-over, zoom in y around the center of the
   // view.  This assumes the two views have the same size on the screen.
   const int other_cell = screen_to_cell_unbounded(V==kX?kY:kX,
-                                     (int)gevent->x, widg->allocation.height/2);
+                                     (int)gevent->x, view_height(V)/2);
 
   const int old_pixy = pixy, old_pixx = pixx;
 
@@ -101,7 +108,7 @@ gboolean dozooming(GtkWidget * widg, GdkEventScroll * gevent, gpointer data)
   // This is hacky.  There is no plane with the right number in the other
   // view, and the cell stagger confuses the coordinates.
   const int other_newtotop = det_to_screen_y(plane+1, other_cell) + pixy/2;
-  *other_yoffset += other_newtotop - widg->allocation.height/2;
+  *other_yoffset += other_newtotop - view_height(V)/2;
 
   // If we're back at the unzoomed view, clear offsets, even though this
   // violates the "don't move the hit under the mouse pointer" rule.
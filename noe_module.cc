@@ -1,6 +1,7 @@
 #include <signal.h>
 
 #include <vector>
+#include <algorithm>
 
 // For getting the event count when the file is opened
 #include "TTree.h"
@@ -11,6 +12,7 @@
 #include "art/Framework/Core/ModuleMacros.h"
 
 #include "RecoBase/CellHit.h"
+#include "RecoBase/Cluster.h"
 
 // For tracks
 #include "Geometry/Geometry.h"
@@ -19,6 +21,14 @@
 
 #include "func/main.h"
 #include "func/event.h"
+#include "func/perf.h"
+#include "func/trace.h"
+#include "func/replay.h"
+#include "func/present.h"
+#include "func/serve.h"
+#include "func/prefetch.h"
+#include "func/ingest.h"
+#include "func/layers.h"
 
 using std::vector;
 
@@ -35,18 +45,65 @@ class noe : public art::EDProducer {
   // Used to get the number of events in the file
   void respondToOpenInputFile(art::FileBlock const &fb);
 
-  // The art labels for tracks and vertices that we are going to display, or
-  // the empty string to display none.
+  // The art labels for slices, tracks and vertices that we are going to
+  // display, or the empty string to display none.  There can be any number
+  // of track and vertex collections, each shown as a layer.  A label is
+  // set to the empty string if it isn't found, to stop looking for it.
   std::string fCellHitLabel;
-  std::string fTrackLabel;
-  std::string fVertexLabel;
+  std::string fSliceLabel;
+  std::vector<std::string> fTrackLabels;
+  std::vector<std::string> fVertexLabels;
+
+  // The layer of each of the above, in the same order
+  std::vector<int> fTrackLayers;
+  std::vector<int> fVertexLayers;
 };
 
+// Get the list of art labels 'key'.  Jobs written before several could be
+// given set one with the same name without the final 's'.  That is still
+// used, if present, so that they show what they asked for.
+static vector<std::string> get_labels(fhicl::ParameterSet const & pset,
+                                      const std::string & key)
+{
+  const std::string oldkey = key.substr(0, key.size()-1);
+  if(!pset.has_key(oldkey))
+    return pset.get< vector<std::string> >(key);
+
+  const std::string label = pset.get< std::string >(oldkey);
+  fprintf(stderr, "Warning: \"%s\" is obsolete.  Use \"%s\", a list of "
+          "labels, instead.  Using \"%s\" as the only one.\n",
+          oldkey.c_str(), key.c_str(), label.c_str());
+  vector<std::string> labels;
+  if(label != "") labels.push_back(label);
+  return labels;
+}
+
 noe::noe(fhicl::ParameterSet const & pset)
 {
   fCellHitLabel = pset.get< std::string >("cellhit_label");
-  fTrackLabel = pset.get< std::string >("track_label");
-  fVertexLabel= pset.get< std::string >("vertex_label");
+  fSliceLabel = pset.get< std::string >("slice_label");
+  fTrackLabels  = get_labels(pset, "track_labels");
+  fVertexLabels = get_labels(pset, "vertex_labels");
+  for(unsigned int i = 0; i < fTrackLabels.size(); i++)
+    fTrackLayers.push_back(layer_add(fTrackLabels[i].c_str(), true));
+  for(unsigned int i = 0; i < fVertexLabels.size(); i++)
+    fVertexLayers.push_back(layer_add(fVertexLabels[i].c_str(), false));
+  perf_enable(pset.get< bool >("perf_hud"));
+  present_enable(pset.get< bool >("remote_frames")? presentremote:
+                 pset.get< bool >("shm_frames")?    presentshm: presentdirect,
+                 pset.get< int >("remote_color_bits"));
+  serve_enable(pset.get< int >("http_port"));
+  prefetch_configure(pset.get< int >("prefetch_budget_ms"),
+                     pset.get< int >("prefetch_ahead"));
+
+  const std::string tracefile = pset.get< std::string >("trace_file");
+  if(tracefile != "") trace_open(tracefile.c_str());
+
+  const std::string recordfile = pset.get< std::string >("record_input");
+  if(recordfile != "") record_open(recordfile.c_str());
+
+  const std::string replayfile = pset.get< std::string >("replay_input");
+  if(replayfile != "") replay_load(replayfile.c_str());
 }
 
 noe::~noe() { }
@@ -83,288 +140,107 @@ void noe::endJob()
   if(!theevents.empty()) realmain(true);
 }
 
-// Inject a test event with all FD cells hit
-__attribute__((unused)) static void add_test_fd_event()
-{
-  noeevent ev;
-  ev.nevent = 0;
-  ev.nrun = 0;
-  ev.nsubrun = 0;
-
-  for(unsigned int c = 0; c < 12 * 32; c++){
-    for(unsigned int p = 0; p < 32 * 28; p++){
-      hit thehit;
-      thehit.cell = c;
-      thehit.plane = p;
-      thehit.adc =  (c*p)%124;
-      thehit.tdc = ((c*p)%432)*4;
-      ev.addhit(thehit);
-    }
-  }
-  theevents.push_back(ev);
-}
-
-// Inject a test event with all ND cells hit
-__attribute__((unused)) static void add_test_nd_event()
-{
-  noeevent ev;
-  ev.nevent = 0;
-  ev.nrun = 0;
-  ev.nsubrun = 0;
-
-  for(unsigned int c = 0; c < 3 * 32; c++){
-    for(unsigned int p = 0; p < 2 * (8 * 12 + 11); p++){
-      if(p >= 2 * 8 * 12 && c >= 2 * 32 && p%2 == 0) continue;
-      hit thehit;
-      thehit.cell = c;
-      thehit.plane = p;
-      thehit.adc = (c*p)%1234;
-      thehit.tdc = ((c*p)% 234)*4;
-      ev.addhit(thehit);
-    }
-  }
-  theevents.push_back(ev);
-}
-
-static vector< vector<float> > xcell_z;
-static vector< vector<float> > ycell_z;
-static vector<float> xplane_z;
-static vector<float> yplane_z;
-static vector< vector<float> > xcell_x;
-static vector< vector<float> > ycell_y;
-
-// Given a position in 3-space, return a plane and cell that is reasonably
-// close in the given view assuming a regular detector geometry.
-static cppoint get_int_plane_and_cell(
-  const double x, const double y, const double z, const geo::View_t view)
-{
-  cppoint ans;
-
-  // (1) First the plane
-  {
-    vector<float> & tplane_z = view == geo::kX?xplane_z:yplane_z;
-
-    const vector<float>::iterator pi
-      = std::upper_bound(tplane_z.begin(), tplane_z.end(), z);
-
-    const int add = (view == geo::kX);
-
-    if(pi == tplane_z.end()){
-      // No plane had as big a 'z' as this, so use the last plane.
-      ans.plane = (tplane_z.size()-1) * 2 + add;
-    }
-    else if(pi == tplane_z.begin()){
-      // 'z' was smaller than the first plane, so that's the closest.
-      ans.plane = add;
-    }
-    else{
-      // Check which is closer, the first plane bigger than 'z', or the
-      // previous one.
-      const float thisone  = fabs( *pi - z);
-      const float previous = fabs( *(pi - 1) - z);
-      if(thisone < previous) ans.plane = (pi - tplane_z.begin())*2 + add;
-      else                   ans.plane = (pi - tplane_z.begin())*2 + add - 2;
-    }
-  }
-
-  // (2) Now find the cell
-  {
-    vector<float> & cells = (view == geo::kX? xcell_x:ycell_y)[ans.plane/2];
-
-    const float t = (view == geo::kX? x: y);
-    const vector<float>::iterator ci
-      = std::upper_bound(cells.begin(), cells.end(), t);
-
-    if(ci == cells.end()){
-      // No cell had as big a 't' as this, so use the last cell.
-      ans.cell = cells.size()-1;
-    }
-    else if(ci == cells.begin()){
-      // 't' was smaller than the first cell, so that's the closest.
-      ans.cell = 0;
-    }
-    else{
-      // Check which is closer
-      const float thisone  = fabs( *ci - t);
-      const float previous = fabs( *(ci - 1) - t);
-      if(thisone < previous) ans.cell = (ci - cells.begin());
-      else                   ans.cell = (ci - cells.begin()) - 1;
-    }
-  }
-
-  return ans;
-}
-
-static void build_cell_lookup_table(art::ServiceHandle<geo::Geometry> & geo)
-{
-  for(unsigned int pl = 0; pl < geo->NPlanes(); pl++){
-    const geo::PlaneGeo * const plane = geo->Plane(pl);
-    geo::View_t view;
-    vector<float> cell_z, cell_t;
-    for(unsigned int ce = 0; ce < plane->Ncells(); ce++){
-      double cellcenter[3], dum[3];
-      geo->CellInfo(pl, ce, &view, cellcenter, dum);
-      cell_z.push_back(cellcenter[2]);
-      cell_t.push_back(geo::kX?cellcenter[0]:cellcenter[1]);
-    }
-
-    (view == geo::kX?xcell_z:ycell_z).push_back(cell_z);
-    (view == geo::kX?xcell_x:ycell_y).push_back(cell_t);
-
-    vector<float> & pz = (view == geo::kX?xplane_z:yplane_z);
-    pz.push_back(cell_z[cell_z.size()/2]);
-  }
-}
-
-// Given a Cartesian position, tp, representing a track point, return the
-// position in floating-point plane and cell number for both views where an
-// integer means the cell center.
-static std::pair<cppoint, cppoint> cart_to_cp(
-  art::ServiceHandle<geo::Geometry> & geo, const TVector3 &tp)
-{
-  // With this lookup table (which isn't really a lookup table), finding
-  // track point uses ~15% of the time spent loading events.  Probably
-  // could go faster, although that's not too bad.
-  {
-    static int first = true;
-    if(first) build_cell_lookup_table(geo);
-    first = false;
-  }
-
-  // For each view, first find a plane and cell which is probably the closest
-  // one, or maybe one of the several closest. Then ask the geometry where that
-  // cell is and store the difference in the fractional part of the cppoint.
-  // This is right up to the difference between the mean plane and cell
-  // spacings and the actual spacing near the requested point.  For purposes of
-  // the event display, it's fine.
-
-  // Exact values are not very important
-  const double meanplanesep = 6.6681604;
-  const double meancellsep  = 3.9674375;
-
-  std::pair<cppoint, cppoint> answer;
-  answer.first = get_int_plane_and_cell(tp.X(), tp.Y(), tp.Z(), geo::kX);
-
-  double cellcenter[3], dum[3];
-  geo::View_t dumv;
-
-  geo->CellInfo(answer.first.plane, answer.first.cell, &dumv, cellcenter, dum);
-  answer.first.fcell  = (tp.X() - cellcenter[0])/meancellsep;
-  answer.first.fplane = (tp.Z() - cellcenter[2])/meanplanesep;
-
-  // Could optimize this by only checking the nearest two planes to the one
-  // found above, but I bet that geo::CellInfo is the hot spot, not
-  // std::upper_bound.
-  answer.second = get_int_plane_and_cell(tp.X(), tp.Y(), tp.Z(), geo::kY);
-
-  geo->CellInfo(answer.second.plane, answer.second.cell, &dumv, cellcenter, dum);
-  answer.second.fcell =  (tp.Y() - cellcenter[1])/meancellsep;
-  answer.second.fplane = (tp.Z() - cellcenter[2])/meanplanesep;
-
-  return answer;
-}
+// Not needed for hits, just for reco, so only set if we are reading reco.
+static art::ServiceHandle<geo::Geometry> * thegeo = NULL;
 
 void noe::produce(art::Event& evt)
 {
   signal(SIGINT, SIG_DFL); // just exit on Ctrl-C
 
+  trace_begin("noe::produce");
+
   art::Handle< vector<rb::CellHit> > cellhits;
 
   if(!evt.getByLabel(fCellHitLabel, cellhits)){
     fprintf(stderr, "NOE needs CellHits with label \"%s\" as configured in your "
       "FCL, but event %d doesn't have those.\n", fCellHitLabel.c_str(), evt.event());
+    trace_end("noe::produce");
     return;
   }
 
-  art::Handle< vector<rb::Track> > tracks;
-  if(fTrackLabel != "" && !evt.getByLabel(fTrackLabel, tracks)){
+  art::Handle< vector<rb::Cluster> > slices;
+  if(fSliceLabel != "" && !evt.getByLabel(fSliceLabel, slices)){
     fprintf(stderr,
-      "Warning: No tracks found with label \"%s\"\n", fTrackLabel.c_str());
-    fTrackLabel = "";
+      "Warning: No slices found with label \"%s\"\n", fSliceLabel.c_str());
+    fSliceLabel = "";
   }
 
-  art::Handle< vector<rb::Vertex> > vertices;
-  if(fVertexLabel != "" && !evt.getByLabel(fVertexLabel, vertices)){
-    fprintf(stderr,
-      "Warning: No vertices found with label \"%s\"\n", fVertexLabel.c_str());
-    fVertexLabel = "";
+  vector< art::Handle< vector<rb::Track> > > tracks(fTrackLabels.size());
+  for(unsigned int i = 0; i < fTrackLabels.size(); i++){
+    if(fTrackLabels[i] != "" && !evt.getByLabel(fTrackLabels[i], tracks[i])){
+      fprintf(stderr, "Warning: No tracks found with label \"%s\"\n",
+              fTrackLabels[i].c_str());
+      fTrackLabels[i] = "";
+    }
+  }
+
+  vector< art::Handle< vector<rb::Vertex> > > vertices(fVertexLabels.size());
+  for(unsigned int i = 0; i < fVertexLabels.size(); i++){
+    if(fVertexLabels[i] != "" && !evt.getByLabel(fVertexLabels[i], vertices[i])){
+      fprintf(stderr, "Warning: No vertices found with label \"%s\"\n",
+              fVertexLabels[i].c_str());
+      fVertexLabels[i] = "";
+    }
   }
 
   // Not needed for hits, just for reco.  Aggressively don't load the
   // Geometry if it isn't needed.
-  static art::ServiceHandle<geo::Geometry> * geo =
-    fVertexLabel == "" && fTrackLabel == ""? NULL:
-    new art::ServiceHandle<geo::Geometry>;
+  bool anyreco = false;
+  for(unsigned int i = 0; i < fTrackLabels.size(); i++)
+    if(fTrackLabels[i] != "") anyreco = true;
+  for(unsigned int i = 0; i < fVertexLabels.size(); i++)
+    if(fVertexLabels[i] != "") anyreco = true;
+  if(thegeo == NULL && anyreco)
+    thegeo = new art::ServiceHandle<geo::Geometry>;
 
-#if 0
-  if(theevents.empty()) add_test_nd_event();
-#endif
+  perf_begin(perfingest);
 
   noeevent ev;
   ev.nevent = evt.event();
   ev.nrun = evt.run();
   ev.nsubrun = evt.subRun();
 
+  // NOvA timestamps have seconds in the upper 32 bits, ns in the lower
+  const uint64_t t = evt.time().value();
+  ev.timestamp = (t >> 32)*1000000000 + (t & 0xffffffff);
+
   // When we're reading in an event, the GUI is unresponsive. This is
   // a consequence of how we're working around art's design choices.
-  // But this loop is not the bottleneck. The delay is inside art, so
+  // But this is not the bottleneck. The delay is inside art, so
   // there's no way to put hooks in the middle of it to keep the GUI
   // responsive.
-  for(unsigned int i = 0; i < cellhits->size(); i++){
-    const rb::CellHit & c = (*cellhits)[i];
-    hit thehit;
-    thehit.cell = c.Cell();
-    thehit.plane = c.Plane();
-    thehit.adc = c.ADC();
-    thehit.tdc = c.TDC();
-    thehit.tns = c.TNS();
-    thehit.good_tns = c.GoodTiming();
-    ev.addhit(thehit);
-  }
-
-  for(unsigned int i = 0; tracks.isValid() && i < tracks->size(); i++){
-    track thetrack;
-    thetrack.startx = 10*(*tracks)[i].Start().X();
-    thetrack.starty = 10*(*tracks)[i].Start().Y();
-    thetrack.startz = 10*(*tracks)[i].Start().Z();
-    thetrack.stopx  = 10*(*tracks)[i].Stop ().X();
-    thetrack.stopy  = 10*(*tracks)[i].Stop ().Y();
-    thetrack.stopz  = 10*(*tracks)[i].Stop ().Z();
-    thetrack.tns  = (*tracks)[i].MeanTNS();
-    thetrack.time = (*tracks)[i].MeanTNS()/1000*64.; // translate to TDC
-    for(unsigned int c = 0; c < (*tracks)[i].NCell(); c++){
-      hit thehit;
-      thehit.cell = (*tracks)[i].Cell(c)->Cell();
-      thehit.plane = (*tracks)[i].Cell(c)->Plane();
-      thetrack.hits.push_back(thehit);
-    }
-    for(unsigned int p = 0; p < (*tracks)[i].NTrajectoryPoints(); p++){
-      const TVector3 & tp = (*tracks)[i].TrajectoryPoint(p);
-      const std::pair<cppoint, cppoint> tps = cart_to_cp(*geo, tp);
-      thetrack.traj[geo::kX].push_back(tps.first);
-      thetrack.traj[geo::kY].push_back(tps.second);
-    }
-    ev.addtrack(thetrack);
-  }
-
-  for(unsigned int i = 0; vertices.isValid() && i < vertices->size(); i++){
-    vertex thevertex;
-    const std::pair<cppoint, cppoint> cp = cart_to_cp(*geo, (*vertices)[i].GetXYZ());
-    thevertex.pos[0] = cp.first;
-    thevertex.pos[1] = cp.second;
-    thevertex.posx  = 10*(*vertices)[i].GetX();
-    thevertex.posy  = 10*(*vertices)[i].GetY();
-    thevertex.posz  = 10*(*vertices)[i].GetZ();
-    thevertex.tns  = (*vertices)[i].GetT();
-    thevertex.time = (*vertices)[i].GetT()/1000*64; // translate to TDC
-    ev.addvertex(thevertex);
-  }
+  fill_event(ev, *cellhits);
+  for(unsigned int i = 0; i < tracks.size(); i++)
+    if(tracks[i].isValid()) add_tracks(ev, *tracks[i], fTrackLayers[i]);
+  for(unsigned int i = 0; i < vertices.size(); i++)
+    if(vertices[i].isValid()) add_vertices(ev, *vertices[i], fVertexLayers[i]);
+  if(slices.isValid()) fill_slices(ev, *slices, cellhits.id());
+  index_hits(ev);
+  summarize_event(ev);
 
   theevents.push_back(ev);
 
+  perf_end(perfingest);
+  trace_end("noe::produce");
+
   realmain(false);
 }
 
 DEFINE_ART_MODULE(noe)
 
 }
+
+// Declared in func/event.h.  Outside of the noe namespace since the drawing
+// code calls it.
+void convert_reco(noeevent & ev)
+{
+  if(ev.reco_converted) return;
+  ev.reco_converted = true;
+
+  // No reco was read, so there is nothing to do
+  if(noe::thegeo == NULL) return;
+
+  perf_begin(perfreco);
+  convert_reco_with_geo(*noe::thegeo, ev);
+  perf_end(perfreco);
+}